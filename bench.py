@@ -32,6 +32,7 @@ sread_sz = 0
 swrite_sz = 0
 timer = 0
 interval = 0
+options = ""
 
 args = sys.argv
 if len(args) < 2:
@@ -47,6 +48,16 @@ for item in content:
     
     if "DRIVE_PATH" in info[0]:
         path = info[1]
+    elif "PRODUCER_CPUS" in info[0]:
+        options += "--producer-cpus " + info[1] + " "
+    elif "CONSUMER_CPUS" in info[0]:
+        options += "--consumer-cpus " + info[1] + " "
+    elif "TIMER_CPUS" in info[0]:
+        options += "--timer-cpus " + info[1] + " "
+    elif "NUMA" in info[0]:
+        options += "--numa " + info[1] + " "
+    elif "ARRIVAL" in info[0]:
+        options += "--arrival " + info[1] + " "
     elif "RANDOM_READ_PROB" in info[0]:
         rread_prob = info[1]
     elif "RANDOM_WRITE_PROB" in info[0]:
@@ -67,6 +78,28 @@ for item in content:
         timer = info[1]
     elif "INTERVAL" in info[0]:
         interval = info[1]
+    elif "ENGINE" in info[0]:
+        options += "--engine " + info[1] + " "
+    elif "IODEPTH" in info[0]:
+        options += "--iodepth " + info[1] + " "
+    elif "QUEUE" in info[0]:
+        options += "--queue " + info[1] + " "
+    elif "CONSUMERS" in info[0]:
+        options += "--consumers " + info[1] + " "
+    elif "FIXED" in info[0]:
+        options += "--fixed " if info[1] == "1" else ""
+    elif "DIRECT" in info[0]:
+        options += "--direct " if info[1] == "1" else ""
+    elif "HUGEPAGES" in info[0]:
+        options += "--hugepages " if info[1] == "1" else ""
+    elif "PER_CORE" in info[0]:
+        options += "--per-core " if info[1] == "1" else ""
+    elif "SEED" in info[0]:
+        options += "--seed " + info[1] + " "
+    elif "REPLAY" in info[0]:
+        options += "--replay " + info[1] + " "
+    elif "SPEED" in info[0]:
+        options += "--speed " + info[1] + " "
     else:
         print "Error [File Parsing] " + info[0]
         exit(1)
@@ -83,7 +116,7 @@ print "  Sequential Write Size........." + swrite_sz + " bytes"
 print "  Timer........................." + timer + " seconds"
 print "  Interval......................" + interval + " seconds"
 
-command = "nice -19 " + name + " "
+command = "nice -19 " + name + " " + options
 command += rread_prob + " " + rwrite_prob + " " + sread_prob + " " + swrite_prob + " "
 command += rread_sz + " " + rwrite_sz + " " + sread_sz + " " + swrite_sz + " "
 command += timer + " " + interval + " " + path
@@ -91,8 +124,12 @@ command += timer + " " + interval + " " + path
 print
 process = subprocess.check_call(command, shell=True) 
 
-# Build graph
-path = path[path.rfind('/')+1:] + ".bin"
+# Build graph, out of the aggregate of every drive if there
+# is more than one.
+if "," in path:
+    path = "aggregate.bin"
+else:
+    path = path[path.rfind('/')+1:] + ".bin"
 content = ""
 
 try:
@@ -186,6 +223,24 @@ except Exception:
     swrite_thru = 0.0
 print swrite_op, swrite_avg, swrite_total, swrite_thru
 
+# Latency percentiles (p0, p50, p90, p99, p99.9, p99.99, p100)
+percentiles = {}
+for kind in ["service", "response", "queueing"]:
+    percentiles[kind] = []
+    for i in range(4):
+        points = struct.unpack("7d", content[offset:offset+56])
+        offset += 56
+        percentiles[kind].append(points)
+        print kind, " ".join(str(p) for p in points)
+
+arrivals, deferred = struct.unpack("2L", content[offset:offset+16])
+offset += 16
+print "deferred", deferred, "of", arrivals
+
+achieved_rate, target_rate = struct.unpack("2d", content[offset:offset+16])
+offset += 16
+print "arrival rate", achieved_rate, "of", target_rate
+
 latencies = [rread_avg, rwrite_avg, sread_avg, swrite_avg]
 thru = [rread_thru, rwrite_thru, sread_thru, swrite_thru]
 
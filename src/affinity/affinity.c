@@ -0,0 +1,170 @@
+/**
+ * Source file for placing threads and memory on CPUs and
+ * NUMA nodes. Only sysfs and the raw system calls are used so
+ * that the benchmark does not depend on libnuma being installed.
+ *
+ * Author: Yash Gupta <yash_gupta12@live.com>
+ * Copyright: Yash Gupta
+ *
+ * License: MIT Public License
+ */
+#include "affinity.h"
+#include <linux/mempolicy.h>
+#include <sys/syscall.h>
+#include <sys/sysmacros.h>
+#include <sys/stat.h>
+#include <limits.h>
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
+
+// Largest NUMA node a preference can be given for.
+#define MAX_NODES   1024
+
+/**
+ * Parse a list of CPUs such as "0-3,8,10-11", the format
+ * used by sysfs and taskset.
+ *
+ * @param   list    The list of CPUs.
+ * @param   set     The set to fill in.
+ *
+ * @return  0       Successfully parsed.
+ * @return  -1      The list is malformed or empty.
+ */
+int
+affinity_parse(const char *list, cpu_set_t *set)
+{
+    unsigned long first, last;
+    char *end;
+
+    CPU_ZERO(set);
+    while (*list && *list != '\n') {
+        first = strtoul(list, &end, 10);
+        if (end == list) {
+            return -1;
+        }
+        last = first;
+        if (*end == '-') {
+            list = end + 1;
+            last = strtoul(list, &end, 10);
+            if (end == list) {
+                return -1;
+            }
+        }
+        if (first > last || last >= CPU_SETSIZE) {
+            return -1;
+        }
+
+        for (; first <= last; first++) {
+            CPU_SET(first, set);
+        }
+        list = (*end == ',')? end + 1: end;
+    }
+
+    return (CPU_COUNT(set))? 0: -1;
+}
+
+/**
+ * Acquire the CPUs of a NUMA node from sysfs.
+ *
+ * @param   node    The node.
+ * @param   set     The set to fill in.
+ *
+ * @return  0       Successfully acquired.
+ * @return  -1      The node does not exist or has no CPUs.
+ */
+int
+affinity_node_cpus(int32_t node, cpu_set_t *set)
+{
+    char path[PATH_MAX], list[4096];
+    FILE *f;
+    int ret;
+
+    snprintf(path, sizeof path, "/sys/devices/system/node/node%d/cpulist", node);
+    f = fopen(path, "r");
+    if (!f) {
+        return -1;
+    }
+
+    ret = (fgets(list, sizeof list, f))? affinity_parse(list, set): -1;
+    fclose(f);
+
+    return ret;
+}
+
+/**
+ * Acquire the NUMA node of the device backing a descriptor.
+ * For a block device that is the device itself, for a regular
+ * file the device holding its file system. The node is read
+ * from the closest ancestor of the device in sysfs which has
+ * one, which is the controller for partitions and namespaces.
+ *
+ * @param   fd      Descriptor of a drive.
+ *
+ * @return  node    The node of the device.
+ * @return  -1      The device has no node, or is virtual.
+ */
+int32_t
+affinity_drive_node(int fd)
+{
+    char link[PATH_MAX + 16], path[PATH_MAX], *slash;
+    struct stat st;
+    dev_t dev;
+    FILE *f;
+    int node;
+
+    if (fstat(fd, &st)) {
+        return -1;
+    }
+    dev = (S_ISBLK(st.st_mode))? st.st_rdev: st.st_dev;
+
+    snprintf(link, sizeof link, "/sys/dev/block/%u:%u", major(dev), minor(dev));
+    if (!realpath(link, path)) {
+        return -1;
+    }
+
+    while ((slash = strrchr(path, '/')) != NULL && strcmp(path, "/sys/devices")) {
+        snprintf(link, sizeof link, "%s/numa_node", path);
+        f = fopen(link, "r");
+        if (f) {
+            if (fscanf(f, "%d", &node) != 1) {
+                node = -1;
+            }
+            fclose(f);
+            return node;
+        }
+        *slash = '\0';
+    }
+
+    return -1;
+}
+
+/**
+ * Prefer a NUMA node for the memory the calling thread faults
+ * in from now on. Memory is still taken from other nodes once
+ * the node runs out, and memory already faulted in stays where
+ * it is.
+ *
+ * @param   node    The node, or a negative node for none.
+ *
+ * @return  0       Successfully set.
+ * @return  -1      set_mempolicy failed.
+ */
+int
+affinity_set_node(int32_t node)
+{
+    unsigned long mask[MAX_NODES / (8 * sizeof(unsigned long))];
+
+    if (node < 0) {
+        return (syscall(__NR_set_mempolicy, MPOL_DEFAULT, NULL, 0) < 0)? -1: 0;
+    }
+    if (node >= MAX_NODES) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    memset(mask, 0, sizeof mask);
+    mask[node / (8 * sizeof(unsigned long))] = 1UL << (node % (8 * sizeof(unsigned long)));
+
+    return (syscall(__NR_set_mempolicy, MPOL_PREFERRED, mask, MAX_NODES + 1) < 0)? -1: 0;
+}
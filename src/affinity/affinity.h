@@ -0,0 +1,49 @@
+/**
+ * Header file for placing threads and memory on CPUs and
+ * NUMA nodes. Only sysfs and the raw system calls are used so
+ * that the benchmark does not depend on libnuma being installed.
+ *
+ * Author: Yash Gupta <yash_gupta12@live.com>
+ * Copyright: Yash Gupta
+ *
+ * License: MIT Public License
+ */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <sched.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+
+#ifndef _AFFINITY_H_
+#define _AFFINITY_H_
+
+/**
+ * Parse a list of CPUs such as "0-3,8,10-11", the format
+ * used by sysfs and taskset.
+ */
+int
+affinity_parse(const char *list, cpu_set_t *set);
+
+/**
+ * Acquire the CPUs of a NUMA node.
+ */
+int
+affinity_node_cpus(int32_t node, cpu_set_t *set);
+
+/**
+ * Acquire the NUMA node of the device backing a descriptor,
+ * -1 if there is none.
+ */
+int32_t
+affinity_drive_node(int fd);
+
+/**
+ * Prefer a NUMA node for the memory the calling thread faults
+ * in from now on, or drop the preference for a negative node.
+ */
+int
+affinity_set_node(int32_t node);
+
+#endif
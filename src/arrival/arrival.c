@@ -0,0 +1,338 @@
+/**
+ * Source file for the arrival processes of a producer. Besides
+ * a homogeneous Poisson process, arrivals can follow a Markov
+ * modulated Poisson process, bursts switched on and off, or a
+ * piecewise constant rate curve loaded from a file.
+ *
+ * Author: Yash Gupta <yash_gupta12@live.com>
+ * Copyright: Yash Gupta
+ *
+ * License: MIT Public License
+ */
+#define _GNU_SOURCE
+#include "arrival.h"
+#include "../expdistrib/expdistrib.h"
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+/**
+ * Allocate the rates and dwells of a process.
+ *
+ * @param   a       The process.
+ * @param   count   Count of states.
+ *
+ * @return  0       Successfully allocated.
+ * @return  -1      Malloc error.
+ */
+static int
+_arrival_alloc(arrival *a, uint32_t count)
+{
+    a->rates = realloc(a->rates, sizeof(*a->rates) * count);
+    a->dwells = realloc(a->dwells, sizeof(*a->dwells) * count);
+
+    return (a->rates && a->dwells)? 0: -1;
+}
+
+/**
+ * Load a rate curve from a file. Every line holds the time in
+ * seconds from the start of the run a point starts at and the
+ * rate from then on, anything after a '#' is a comment. The
+ * first point starts at 0 and times strictly increase.
+ *
+ * Eg: "0 2000", "30 20000", "45 2000" for a 15 second spike.
+ *
+ * @param   a       The process to fill in.
+ * @param   path    Path of the curve.
+ *
+ * @return  0       Successfully loaded.
+ * @return  -1      The file could not be opened or is malformed.
+ */
+static int
+_arrival_load_curve(arrival *a, const char *path)
+{
+    char *line = NULL, *end;
+    double time, rate, last = 0;
+    size_t cap = 0;
+    uint32_t cap_points = 0;
+    FILE *f;
+    int ret = 0;
+
+    f = fopen(path, "r");
+    if (!f) {
+        return -1;
+    }
+
+    while (!ret && getline(&line, &cap, f) != -1) {
+        if ((end = strchr(line, '#')) != NULL) {
+            *end = '\0';
+        }
+        if (sscanf(line, "%lf %lf", &time, &rate) != 2) {
+            ret = (strspn(line, " \t\r\n") == strlen(line))? 0: -1;
+            continue;
+        }
+        if (!(rate >= 0) || (a->count && !(time > last)) || (!a->count && time != 0)) {
+            ret = -1;
+            break;
+        }
+
+        if (a->count == cap_points) {
+            cap_points = (cap_points)? 2 * cap_points: 64;
+            if (_arrival_alloc(a, cap_points)) {
+                ret = -1;
+                break;
+            }
+        }
+        if (a->count) {
+            a->dwells[a->count - 1] = time - last;
+        }
+        a->rates[a->count] = rate;
+        a->dwells[a->count] = INFINITY;
+        a->count++;
+        last = time;
+    }
+
+    free(line);
+    fclose(f);
+
+    // The last point lasts forever, so it must see arrivals.
+    return (ret || !a->count || !(a->rates[a->count - 1] > 0))? -1: 0;
+}
+
+/**
+ * Parse an arrival process, one of:
+ *
+ *  mmpp:RATE@DWELL,...             Markov modulated Poisson, with
+ *                                  up to ARRIVAL_MAX_STATES states.
+ *  onoff:RATE:ON:OFF               RATE for ON seconds, then none
+ *                                  for OFF seconds.
+ *  curve:FILE                      A rate curve, see _arrival_load_curve.
+ *
+ * Rates are in arrivals per second and dwells in seconds.
+ *
+ * Eg: "mmpp:2000@10,50000@0.5" for bursts of half a second
+ * about every 10 seconds.
+ *
+ * @param   a       The process to fill in.
+ * @param   spec    The process to parse.
+ *
+ * @return  0       Successfully parsed.
+ * @return  -1      The process is malformed.
+ */
+int
+arrival_parse(arrival *a, const char *spec)
+{
+    double total = 0;
+    char *end;
+    uint32_t i;
+
+    memset(a, 0, sizeof *a);
+    a->scale = 1;
+
+    if (!strncmp(spec, "mmpp:", 5)) {
+        a->model = ARRIVAL_MMPP;
+        if (_arrival_alloc(a, ARRIVAL_MAX_STATES)) {
+            return -1;
+        }
+        end = (char*)spec + 4;
+        do {
+            if (a->count == ARRIVAL_MAX_STATES) {
+                return -1;
+            }
+            a->rates[a->count] = strtod(end + 1, &end);
+            if (*end != '@') {
+                return -1;
+            }
+            a->dwells[a->count] = strtod(end + 1, &end);
+            if (!(a->rates[a->count] >= 0) || !(a->dwells[a->count] > 0)) {
+                return -1;
+            }
+            total += a->rates[a->count++];
+        } while (*end == ',');
+        return (*end || !(total > 0))? -1: 0;
+    }
+
+    if (!strncmp(spec, "onoff:", 6)) {
+        a->model = ARRIVAL_ONOFF;
+        if (_arrival_alloc(a, 2)) {
+            return -1;
+        }
+        a->count = 2;
+        a->rates[0] = strtod(spec + 6, &end);
+        a->rates[1] = 0;
+        for (i = 0; i < 2; i++) {
+            if (*end != ':') {
+                return -1;
+            }
+            a->dwells[i] = strtod(end + 1, &end);
+        }
+        return (*end || !(a->rates[0] > 0) || !(a->dwells[0] > 0) || !(a->dwells[1] >= 0))? -1: 0;
+    }
+
+    if (!strncmp(spec, "curve:", 6)) {
+        a->model = ARRIVAL_CURVE;
+        return _arrival_load_curve(a, spec + 6);
+    }
+
+    return -1;
+}
+
+/**
+ * Set up a homogeneous Poisson process.
+ *
+ * @param   a       The process to set up.
+ * @param   rate    Arrivals per second.
+ */
+void
+arrival_poisson(arrival *a, double rate)
+{
+    memset(a, 0, sizeof *a);
+    a->model = ARRIVAL_POISSON;
+    a->count = 1;
+    a->scale = rate;
+    a->left = INFINITY;
+}
+
+/**
+ * Set up the copy of a process for a single producer, at an
+ * even share of its rate. Every copy starts out in the first
+ * state. The first dwell of an MMPP is drawn out of the random
+ * stream of the producer like every other, so that the copies
+ * of the producers of a drive switch states independently
+ * rather than all at once.
+ *
+ * @param   dst     The copy to set up.
+ * @param   src     The process.
+ * @param   shares  Count of producers sharing the process.
+ * @param   r       Random stream of the producer.
+ */
+void
+arrival_share(arrival *dst, const arrival *src, uint32_t shares, rng *r)
+{
+    *dst = *src;
+    dst->scale = src->scale / shares;
+    dst->state = 0;
+    switch (src->model) {
+    case ARRIVAL_POISSON:
+        dst->left = INFINITY;
+        break;
+
+    case ARRIVAL_MMPP:
+        dst->left = get_exponential_variate(r, 1 / src->dwells[0]);
+        break;
+
+    default:
+        dst->left = src->dwells[0];
+    }
+}
+
+/**
+ * Acquire the mean rate of a process over its first duration
+ * seconds. The state an MMPP is in is random, so its long run
+ * mean is taken instead, which weighs every rate by its dwell.
+ *
+ * @param   a           The process.
+ * @param   duration    Seconds the process runs for.
+ *
+ * @return  rate        Mean arrivals per second.
+ */
+double
+arrival_mean_rate(const arrival *a, double duration)
+{
+    double arrivals = 0, time = 0, span, total = 0;
+    uint32_t i;
+
+    switch (a->model) {
+    case ARRIVAL_POISSON:
+        return a->scale;
+
+    case ARRIVAL_MMPP:
+        for (i = 0; i < a->count; i++) {
+            arrivals += a->rates[i] * a->dwells[i];
+            total += a->dwells[i];
+        }
+        return a->scale * arrivals / total;
+
+    default:
+        for (i = 0; time < duration; i = (i + 1) % a->count) {
+            span = (a->dwells[i] < duration - time)? a->dwells[i]: duration - time;
+            arrivals += a->rates[i] * span;
+            time += span;
+        }
+        return (duration > 0)? a->scale * arrivals / duration: a->scale * a->rates[0];
+    }
+}
+
+/**
+ * Move a process on to its next state.
+ *
+ * @param   a       The process.
+ * @param   r       Random stream of the producer.
+ */
+static void
+_arrival_next(arrival *a, rng *r)
+{
+    uint32_t next;
+
+    if (a->model == ARRIVAL_MMPP) {
+        if (a->count > 1) {
+            next = rng_bounded(r, a->count - 1);
+            a->state = (next >= a->state)? next + 1: next;
+        }
+        a->left = get_exponential_variate(r, 1 / a->dwells[a->state]);
+    } else {
+        a->state = (a->state + 1 < a->count)? a->state + 1: 0;
+        a->left = a->dwells[a->state];
+    }
+}
+
+/**
+ * Fill an array with the next count inter-arrival gaps of a
+ * process, in seconds. A Poisson process draws them all in a
+ * single vectorized pass, the others one at a time.
+ *
+ * @param   a       The process.
+ * @param   r       Random stream of the producer.
+ * @param   gaps    The gaps to fill in.
+ * @param   count   Count of gaps.
+ */
+void
+arrival_gaps(arrival *a, rng *r, double *gaps, uint64_t count)
+{
+    double gap, e, rate;
+    uint64_t i;
+
+    if (a->model == ARRIVAL_POISSON) {
+        get_exponential_variates(r, a->scale, gaps, count);
+        return;
+    }
+
+    for (i = 0; i < count; i++) {
+        gap = 0;
+        for (;;) {
+            rate = a->rates[a->state] * a->scale;
+            e = (rate > 0)? get_exponential_variate(r, rate): INFINITY;
+            if (e < a->left) {
+                a->left -= e;
+                break;
+            }
+            gap += a->left;
+            _arrival_next(a, r);
+        }
+        gaps[i] = gap + e;
+    }
+}
+
+/**
+ * Deallocate the rates and dwells of a parsed process. Copies
+ * of the process are left dangling.
+ *
+ * @param   a       The process.
+ */
+void
+arrival_free(arrival *a)
+{
+    free(a->rates);
+    free(a->dwells);
+    a->rates = a->dwells = NULL;
+}
@@ -0,0 +1,105 @@
+/**
+ * Header file for the arrival processes of a producer. Besides
+ * a homogeneous Poisson process, arrivals can follow a Markov
+ * modulated Poisson process, bursts switched on and off, or a
+ * piecewise constant rate curve loaded from a file.
+ *
+ * Author: Yash Gupta <yash_gupta12@live.com>
+ * Copyright: Yash Gupta
+ *
+ * License: MIT Public License
+ */
+#include "../rng/rng.h"
+#include <stdlib.h>
+#include <stdint.h>
+
+#ifndef _ARRIVAL_H_
+#define _ARRIVAL_H_
+
+// Largest number of states of a modulated process.
+#define ARRIVAL_MAX_STATES  16
+
+// Arrival Models
+enum arrival_model {
+    ARRIVAL_POISSON = 0,
+    ARRIVAL_MMPP,
+    ARRIVAL_ONOFF,
+    ARRIVAL_CURVE
+};
+
+typedef struct arrival {
+    /*
+     * Every model is a sequence of states, each of which is
+     * a Poisson process at rates[i] arrivals per second for
+     * dwells[i] seconds. The models differ in how long a state
+     * lasts and which state follows:
+     *
+     *  --> Poisson: a single state which lasts forever, at the
+     *      rate of scale alone, without any rates or dwells.
+     *  --> MMPP: a state lasts an exponentially distributed
+     *      time of mean dwells[i] and is followed by any other
+     *      state, drawn uniformly.
+     *  --> On/off: an on state at the rate, then an off state
+     *      without arrivals, each for its exact dwell.
+     *  --> Curve: every point of the curve lasts until the next
+     *      one, the last one lasts forever.
+     *
+     * Since a Poisson process is memoryless, a gap which runs
+     * past the end of a state can be cut short there and drawn
+     * anew at the rate of the next state, which samples the non
+     * homogeneous process exactly. Rates are multiplied by scale,
+     * so that producers sharing a drive share its rate too. The
+     * rates and dwells are shared by every copy of a process.
+     */
+    uint8_t model;
+    uint32_t count;
+    double *rates;
+    double *dwells;
+    double scale;
+
+    // State of the copy of a single producer.
+    uint32_t state;
+    double left;
+} arrival;
+
+/**
+ * Parse an arrival process such as "mmpp:RATE@DWELL,...",
+ * "onoff:RATE:ON:OFF" or "curve:FILE".
+ */
+int
+arrival_parse(arrival *a, const char *spec);
+
+/**
+ * Set up a homogeneous Poisson process.
+ */
+void
+arrival_poisson(arrival *a, double rate);
+
+/**
+ * Set up the copy of a process for a single producer, at an
+ * even share of its rate.
+ */
+void
+arrival_share(arrival *dst, const arrival *src, uint32_t shares, rng *r);
+
+/**
+ * Acquire the mean rate of a process over its first duration
+ * seconds.
+ */
+double
+arrival_mean_rate(const arrival *a, double duration);
+
+/**
+ * Fill an array with the next count inter-arrival gaps of a
+ * process, in seconds.
+ */
+void
+arrival_gaps(arrival *a, rng *r, double *gaps, uint64_t count);
+
+/**
+ * Deallocate the rates and dwells of a parsed process.
+ */
+void
+arrival_free(arrival *a);
+
+#endif
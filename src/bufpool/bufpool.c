@@ -0,0 +1,109 @@
+/**
+ * Source file for a pool of aligned I/O buffers which are
+ * allocated once and recycled for the lifetime of a run.
+ *
+ * Author: Yash Gupta <yash_gupta12@live.com>
+ * Copyright: Yash Gupta
+ *
+ * License: MIT Public License
+ */
+#include "bufpool.h"
+#include <sys/mman.h>
+#include <string.h>
+#include <unistd.h>
+
+// Size of a huge page assumed when rounding the mapping.
+#define HUGE_PAGE_SIZE  (2UL << 20)
+
+/**
+ * Create a pool of count buffers of at least size bytes,
+ * each aligned to the specified alignment. The whole pool
+ * is a single anonymous mapping, so it is page aligned and
+ * prefaulted. Every buffer is filled with a constant once so
+ * writes never need to touch their buffer again.
+ *
+ * In case huge pages are requested but none are reserved,
+ * the pool falls back to transparent huge pages.
+ *
+ * @param   count   Count of buffers in the pool.
+ * @param   size    Minimum size of each buffer.
+ * @param   align   Alignment of each buffer (power of two).
+ * @param   huge    Back the pool with huge pages.
+ *
+ * @return  A buffer pool.
+ * @return  NULL    malloc failed.
+ * @return  NULL    mmap failed.
+ */
+bufpool*
+bufpool_create(uint64_t count, uint64_t size, uint64_t align, uint8_t huge)
+{
+    bufpool *pool;
+    long page;
+
+    pool = malloc(sizeof *pool);
+    if (!pool) {
+        return NULL;
+    }
+
+    page = sysconf(_SC_PAGESIZE);
+    if (align < (uint64_t)page) {
+        align = page;
+    }
+
+    pool->count = count;
+    pool->size = (size + align - 1) & ~(align - 1);
+    pool->map_len = pool->count * pool->size;
+    pool->huge = 0;
+
+    if (huge) {
+        pool->map_len = (pool->map_len + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+        pool->base = mmap(NULL, pool->map_len, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_POPULATE, -1, 0);
+        if (pool->base != MAP_FAILED) {
+            pool->huge = 1;
+            goto fill;
+        }
+    }
+
+    pool->base = mmap(NULL, pool->map_len, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (pool->base == MAP_FAILED) {
+        free(pool);
+        return NULL;
+    }
+    if (huge) {
+        madvise(pool->base, pool->map_len, MADV_HUGEPAGE);
+    }
+
+fill:
+    memset(pool->base, 49, pool->map_len);
+    return pool;
+}
+
+/**
+ * Deallocate space acquired by a buffer pool.
+ *
+ * @param   pool    The pool to deallocate.
+ */
+void
+bufpool_free(bufpool *pool)
+{
+    munmap(pool->base, pool->map_len);
+    free(pool);
+}
+
+/**
+ * Acquire the buffer at the specified index in the pool.
+ *
+ * @param   pool    The pool to get a buffer from.
+ * @param   index   The index of the buffer.
+ *
+ * @return  buf     The buffer at index.
+ * @return  NULL    pool is NULL.
+ * @return  NULL    index >= pool->count.
+ */
+void*
+bufpool_get(bufpool *pool, uint64_t index)
+{
+    return (pool && index < pool->count)? (char*)pool->base + index * pool->size: NULL;
+}
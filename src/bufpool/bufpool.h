@@ -0,0 +1,43 @@
+/**
+ * Header file for a pool of aligned I/O buffers which are
+ * allocated once and recycled for the lifetime of a run.
+ *
+ * Author: Yash Gupta <yash_gupta12@live.com>
+ * Copyright: Yash Gupta
+ *
+ * License: MIT Public License
+ */
+#include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+
+#ifndef _BUFPOOL_H_
+#define _BUFPOOL_H_
+
+typedef struct bufpool {
+    void *base;
+    uint64_t count, size;
+    size_t map_len;
+    uint8_t huge;
+} bufpool;
+
+/**
+ * Create a pool of count buffers of at least size bytes,
+ * each aligned to the specified alignment.
+ */
+bufpool*
+bufpool_create(uint64_t count, uint64_t size, uint64_t align, uint8_t huge);
+
+/**
+ * Deallocate space acquired by a buffer pool.
+ */
+void
+bufpool_free(bufpool *pool);
+
+/**
+ * Acquire the buffer at the specified index in the pool.
+ */
+void*
+bufpool_get(bufpool *pool, uint64_t index);
+
+#endif
@@ -8,16 +8,36 @@
  * License: MIT Public License
  */
 #include "cirq.h"
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <limits.h>
+#include <string.h>
+#include <unistd.h>
+
+// Queue types which are guarded by the mutex and conditions.
+#define CIRQ_IS_LOCKING(q)  ((q)->type == CIRQ_LOCKING || (q)->type == CIRQ_LOCKING_AND_BLOCKING)
+#define CIRQ_IS_BLOCKING(q) ((q)->type == CIRQ_LOCKING_AND_BLOCKING)
+#define CIRQ_IS_LOCKFREE(q) ((q)->type == CIRQ_LOCKFREE_SPSC || (q)->type == CIRQ_LOCKFREE_MPMC)
+
+// Number of times a lock-free side polls before it sleeps.
+#define CIRQ_SPIN_COUNT     1024
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CIRQ_CPU_RELAX()    __builtin_ia32_pause()
+#else
+#define CIRQ_CPU_RELAX()    __asm__ __volatile__("" ::: "memory")
+#endif
 
 /**
  * Create a circular queue of of the specfied
  * size.
  * 
  * @param   count       Count of items in Queue.
- * @param   type        single or multi threaded queue.
+ * @param   type        single or multi threaded, locking or lock-free queue.
  * 
  * @return  A circular queue.
  * @return  NULL        malloc failed.
+ * @return  NULL        sequence alloc failed.
  * @return  NULL        mutex init failed.
  * @return  NULL        cond init failed.
  */
@@ -25,28 +45,62 @@ cirq*
 cirq_create(uint64_t count, uint8_t type)
 {
     cirq *q;
+    uint64_t i;
 
-    q = malloc(sizeof *q);
+    // The lock-free sides are cache line aligned, and so
+    // needs to be the queue holding them.
+    q = aligned_alloc(CIRQ_CACHE_LINE, sizeof *q);
     if (!q) {
         return NULL;
     }
+    memset(q, 0, sizeof *q);
+
+    // Lock-free queues mask their indices rather than
+    // take a modulo, so they need a power of two length.
+    if (type == CIRQ_LOCKFREE_SPSC || type == CIRQ_LOCKFREE_MPMC) {
+        while (count & (count - 1)) {
+            count += count & -count;
+        }
+    }
 
     q->head = q->tail = 0;
+    q->closed = 0;
     q->len = count;
+    q->mask = count - 1;
+
+    // Spinning only helps if the other side can run at the
+    // same time.
+    q->spin = (sysconf(_SC_NPROCESSORS_ONLN) > 1)? CIRQ_SPIN_COUNT: 0;
     q->store = malloc(sizeof(void*) * count);
     if (!q->store) {
         goto store_alloc_fail;
     }
 
     q->type = type;
-    if (q->type > CIRQ_SINGLE_THREAD) {
+    if (q->type == CIRQ_LOCKFREE_MPMC) {
+        q->seq = malloc(sizeof(*q->seq) * count);
+        if (!q->seq) {
+            goto seq_alloc_fail;
+        }
+
+        // Slot i is ready to be written on the first lap.
+        for (i = 0; i < count; i++) {
+            q->seq[i] = i;
+        }
+    }
+
+    if (CIRQ_IS_LOCKING(q)) {
         if (pthread_mutex_init(&q->lock, NULL)) {
             goto mutex_init_fail;
         }
     }
 
-    if (q->type > CIRQ_LOCKING) {
-        if (pthread_cond_init(&q->cond, NULL)) {
+    if (CIRQ_IS_BLOCKING(q)) {
+        if (pthread_cond_init(&q->not_empty, NULL)) {
+            goto cond_init_fail;
+        }
+        if (pthread_cond_init(&q->not_full, NULL)) {
+            pthread_cond_destroy(&q->not_empty);
             goto cond_init_fail;
         }
     }
@@ -57,6 +111,9 @@ cond_init_fail:
     pthread_mutex_destroy(&q->lock);
 
 mutex_init_fail:
+    free(q->seq);
+
+seq_alloc_fail:
     free(q->store);
 
 store_alloc_fail:
@@ -73,140 +130,676 @@ store_alloc_fail:
 void
 cirq_free(cirq *q)
 {
-    if (q->type > CIRQ_SINGLE_THREAD) {
+    if (CIRQ_IS_LOCKING(q)) {
         pthread_mutex_destroy(&q->lock);
     }
 
-    if (q->type > CIRQ_LOCKING) {
-        pthread_cond_destroy(&q->cond);
+    if (CIRQ_IS_BLOCKING(q)) {
+        pthread_cond_destroy(&q->not_empty);
+        pthread_cond_destroy(&q->not_full);
     }
 
+    free(q->seq);
     free(q->store);
     free(q);
 }
 
 /**
- * Acquire the element at the head of the circular queue
- * in case the queue is not empty.
+ * Put a thread of a lock-free side to sleep until the watched
+ * word moves away from the specified value, or the queue is
+ * closed. The thread spins for a while before it sleeps on the
+ * event of its side so that a busy queue never enters the kernel.
+ * 
+ * @param   q       The queue to wait on.
+ * @param   self    The side which waits.
+ * @param   watch   The word to watch (index or slot sequence).
+ * @param   value   The value the word needs to move away from.
+ * 
+ * @return  1       The word moved.
+ * @return  0       The queue is closed.
+ */
+static int
+_cirq_lf_wait(cirq *q, struct cirq_side *self, uint64_t *watch, uint64_t value)
+{
+    uint32_t spin, event;
+
+    for (spin = 0; ; spin++) {
+        if (__atomic_load_n(watch, __ATOMIC_ACQUIRE) != value) {
+            return 1;
+        }
+        if (__atomic_load_n(&q->closed, __ATOMIC_ACQUIRE)) {
+            return 0;
+        }
+
+        if (spin < q->spin) {
+            CIRQ_CPU_RELAX();
+            continue;
+        }
+
+        // Announce the sleep before checking the word one
+        // last time. The other side publishes the word before
+        // checking for sleepers, so one of the two always sees
+        // the other. A wake between the check and the sleep
+        // bumps the event, so the futex does not sleep at all.
+        event = __atomic_load_n(&self->event, __ATOMIC_ACQUIRE);
+        __atomic_add_fetch(&self->sleepers, 1, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(watch, __ATOMIC_SEQ_CST) == value &&
+            !__atomic_load_n(&q->closed, __ATOMIC_SEQ_CST)) {
+            syscall(SYS_futex, &self->event, FUTEX_WAIT_PRIVATE, event, NULL, NULL, 0);
+        }
+        __atomic_sub_fetch(&self->sleepers, 1, __ATOMIC_SEQ_CST);
+    }
+}
+
+/**
+ * Wake threads of a lock-free side in case any are asleep.
+ * Must be called after the word they might be waiting on has
+ * been published.
+ * 
+ * @param   side    The side to wake.
+ * @param   count   The maximum number of threads to wake.
+ */
+static void
+_cirq_lf_wake(struct cirq_side *side, int count)
+{
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&side->sleepers, __ATOMIC_RELAXED)) {
+        __atomic_add_fetch(&side->event, 1, __ATOMIC_RELEASE);
+        syscall(SYS_futex, &side->event, FUTEX_WAKE_PRIVATE, count, NULL, NULL, 0);
+    }
+}
+
+/**
+ * Acquire up to count elements at the head of a single
+ * producer, single consumer lock-free queue.
  * 
  * @param   q       The queue to dequeue from.
+ * @param   items   Array to store the elements in.
+ * @param   count   Maximum number of elements to dequeue.
+ * @param   block   Wait for an element if the queue is empty.
  * 
- * @return  item    The item at head of queue.
- * @return  NULL    q is NULL.
- * @return  NULL    q is empty and non blocking.
+ * @return  n       The number of elements dequeued.
+ * @return  0       q is empty and non blocking.
+ * @return  0       q is empty and closed.
+ */
+static uint64_t
+_cirq_spsc_get(cirq *q, void **items, uint64_t count, int block)
+{
+    uint64_t head, avail, i;
+
+    head = q->cons.index;
+    if (q->cons.cached - head < count) {
+        q->cons.cached = __atomic_load_n(&q->prod.index, __ATOMIC_ACQUIRE);
+        if (head == q->cons.cached) {
+            if (!block || !_cirq_lf_wait(q, &q->cons, &q->prod.index, head)) {
+                return 0;
+            }
+            q->cons.cached = __atomic_load_n(&q->prod.index, __ATOMIC_ACQUIRE);
+        }
+    }
+
+    avail = q->cons.cached - head;
+    count = (avail < count)? avail: count;
+    for (i = 0; i < count; i++) {
+        items[i] = q->store[(head + i) & q->mask];
+    }
+
+    __atomic_store_n(&q->cons.index, head + count, __ATOMIC_RELEASE);
+    _cirq_lf_wake(&q->prod, 1);
+
+    return count;
+}
+
+/**
+ * Put up to count elements at the tail of a single producer,
+ * single consumer lock-free queue.
  * 
- * NOTE: This function blocks in case the queue is empty.
+ * @param   q       The queue to enqueue into.
+ * @param   items   The elements to enqueue.
+ * @param   count   Number of elements to enqueue.
+ * @param   block   Wait for space if the queue is full.
+ * 
+ * @return  n       The number of elements enqueued.
+ * @return  0       q is full and non blocking.
+ * @return  0       q is closed.
  */
-void*
-cirq_get(cirq *q)
+static uint64_t
+_cirq_spsc_put(cirq *q, void **items, uint64_t count, int block)
 {
-    void *item = NULL;
+    uint64_t tail, space, i;
 
-    if (!q) {
-        return NULL;
+    if (__atomic_load_n(&q->closed, __ATOMIC_ACQUIRE)) {
+        return 0;
+    }
+
+    tail = q->prod.index;
+    if (q->len - (tail - q->prod.cached) < count) {
+        q->prod.cached = __atomic_load_n(&q->cons.index, __ATOMIC_ACQUIRE);
+        if (tail - q->prod.cached == q->len) {
+            if (!block || !_cirq_lf_wait(q, &q->prod, &q->cons.index, tail - q->len)) {
+                return 0;
+            }
+            q->prod.cached = __atomic_load_n(&q->cons.index, __ATOMIC_ACQUIRE);
+        }
+    }
+
+    space = q->len - (tail - q->prod.cached);
+    count = (space < count)? space: count;
+    for (i = 0; i < count; i++) {
+        q->store[(tail + i) & q->mask] = items[i];
+    }
+
+    __atomic_store_n(&q->prod.index, tail + count, __ATOMIC_RELEASE);
+    _cirq_lf_wake(&q->cons, 1);
+
+    return count;
+}
+
+/**
+ * Acquire up to count elements at the head of a multi producer,
+ * multi consumer lock-free queue. A slot holds an element for the
+ * consumer at position pos once its sequence is pos + 1. The run
+ * of consecutive ready slots is claimed with a single compare and
+ * swap; no other consumer can claim any of them once the index
+ * has moved past them.
+ * 
+ * @param   q       The queue to dequeue from.
+ * @param   items   Array to store the elements in.
+ * @param   count   Maximum number of elements to dequeue.
+ * @param   block   Wait for an element if the queue is empty.
+ * 
+ * @return  n       The number of elements dequeued.
+ * @return  0       q is empty and non blocking.
+ * @return  0       q is empty and closed.
+ */
+static uint64_t
+_cirq_mpmc_get(cirq *q, void **items, uint64_t count, int block)
+{
+    uint64_t pos, seq, n, i;
+    int64_t dif;
+
+    pos = __atomic_load_n(&q->cons.index, __ATOMIC_RELAXED);
+    while (1) {
+        seq = __atomic_load_n(&q->seq[pos & q->mask], __ATOMIC_ACQUIRE);
+        dif = (int64_t)(seq - (pos + 1));
+
+        if (dif == 0) {
+            for (n = 1; n < count; n++) {
+                if (__atomic_load_n(&q->seq[(pos + n) & q->mask], __ATOMIC_ACQUIRE) != pos + n + 1) {
+                    break;
+                }
+            }
+            if (__atomic_compare_exchange_n(&q->cons.index, &pos, pos + n, 1,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break;
+            }
+        } else if (dif < 0) {
+            if (!block || !_cirq_lf_wait(q, &q->cons, &q->seq[pos & q->mask], seq)) {
+                return 0;
+            }
+            pos = __atomic_load_n(&q->cons.index, __ATOMIC_RELAXED);
+        } else {
+            pos = __atomic_load_n(&q->cons.index, __ATOMIC_RELAXED);
+        }
+    }
+
+    // Hand the slots to the producers of the next lap.
+    for (i = 0; i < n; i++) {
+        items[i] = q->store[(pos + i) & q->mask];
+        __atomic_store_n(&q->seq[(pos + i) & q->mask], pos + i + q->len, __ATOMIC_RELEASE);
+    }
+    _cirq_lf_wake(&q->prod, n);
+
+    return n;
+}
+
+/**
+ * Put up to count elements at the tail of a multi producer,
+ * multi consumer lock-free queue. A slot is free for the producer
+ * at position pos once its sequence is pos. The run of consecutive
+ * free slots is claimed with a single compare and swap.
+ * 
+ * @param   q       The queue to enqueue into.
+ * @param   items   The elements to enqueue.
+ * @param   count   Number of elements to enqueue.
+ * @param   block   Wait for space if the queue is full.
+ * 
+ * @return  n       The number of elements enqueued.
+ * @return  0       q is full and non blocking.
+ * @return  0       q is closed.
+ */
+static uint64_t
+_cirq_mpmc_put(cirq *q, void **items, uint64_t count, int block)
+{
+    uint64_t pos, seq, n, i;
+    int64_t dif;
+
+    if (__atomic_load_n(&q->closed, __ATOMIC_ACQUIRE)) {
+        return 0;
+    }
+
+    pos = __atomic_load_n(&q->prod.index, __ATOMIC_RELAXED);
+    while (1) {
+        seq = __atomic_load_n(&q->seq[pos & q->mask], __ATOMIC_ACQUIRE);
+        dif = (int64_t)(seq - pos);
+
+        if (dif == 0) {
+            for (n = 1; n < count; n++) {
+                if (__atomic_load_n(&q->seq[(pos + n) & q->mask], __ATOMIC_ACQUIRE) != pos + n) {
+                    break;
+                }
+            }
+            if (__atomic_compare_exchange_n(&q->prod.index, &pos, pos + n, 1,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break;
+            }
+        } else if (dif < 0) {
+            if (!block || !_cirq_lf_wait(q, &q->prod, &q->seq[pos & q->mask], seq)) {
+                return 0;
+            }
+            pos = __atomic_load_n(&q->prod.index, __ATOMIC_RELAXED);
+        } else {
+            pos = __atomic_load_n(&q->prod.index, __ATOMIC_RELAXED);
+        }
+    }
+
+    // Hand the slots to the consumers of this lap.
+    for (i = 0; i < n; i++) {
+        q->store[(pos + i) & q->mask] = items[i];
+        __atomic_store_n(&q->seq[(pos + i) & q->mask], pos + i + 1, __ATOMIC_RELEASE);
+    }
+    _cirq_lf_wake(&q->cons, n);
+
+    return n;
+}
+
+/**
+ * Acquire up to count elements at the head of the circular
+ * queue in case the queue is not empty.
+ * 
+ * @param   q       The queue to dequeue from.
+ * @param   items   Array to store the elements in.
+ * @param   count   Maximum number of elements to dequeue.
+ * @param   block   Wait for an element if the queue is empty.
+ * 
+ * @return  n       The number of elements dequeued.
+ * @return  0       q is NULL.
+ * @return  0       q is empty and non blocking.
+ * @return  0       q is empty and closed.
+ */
+static uint64_t
+_cirq_get(cirq *q, void **items, uint64_t count, int block)
+{
+    uint64_t n = 0;
+
+    if (!q || !count) {
+        return 0;
+    }
+
+    if (q->type == CIRQ_LOCKFREE_SPSC) {
+        return _cirq_spsc_get(q, items, count, block);
+    } else if (q->type == CIRQ_LOCKFREE_MPMC) {
+        return _cirq_mpmc_get(q, items, count, block);
     }
 
     // Acquire mutex if required.
-    if (q->type > CIRQ_SINGLE_THREAD) {
+    if (CIRQ_IS_LOCKING(q)) {
         pthread_mutex_lock(&q->lock);
     }
 
     if (q->head == q->tail) {
-        if (q->type != CIRQ_LOCKING_AND_BLOCKING) {
+        if (!block || q->closed) {
             goto release_mutex;
         }
         
         // The consumer will go to sleep until a
         // signal wakes it. It needs to confirm on
         // wake that indeed the queue is no longer
-        // empty.
+        // empty, or that it has been closed.
         do {
-            pthread_cond_wait(&q->cond, &q->lock);
-        } while (q->head == q->tail);
+            pthread_cond_wait(&q->not_empty, &q->lock);
+        } while (q->head == q->tail && !q->closed);
+
+        if (q->head == q->tail) {
+            goto release_mutex;
+        }
     }
 
-    item = q->store[q->head];
-    q->head = (q->head + 1) % q->len;
+    while (n < count && q->head != q->tail) {
+        items[n++] = q->store[q->head];
+        q->head = (q->head + 1) % q->len;
+    }
 
-    // Signal any producers waiting on this condition.
-    // Has no effect if nothing is waiting. This signal
-    // can be sent even though the current thread own the
-    // mutex [pthread_cond_signal man page].
+    // Signal any producers waiting on the queue to no
+    // longer be full. Has no effect if nothing is waiting.
+    // This signal can be sent even though the current thread
+    // own the mutex [pthread_cond_signal man page].
     if (q->type == CIRQ_LOCKING_AND_BLOCKING) {
-        pthread_cond_signal(&q->cond);        
+        pthread_cond_signal(&q->not_full);
     }
 
 release_mutex:
-    if (q->type > CIRQ_SINGLE_THREAD) {
+    if (CIRQ_IS_LOCKING(q)) {
         pthread_mutex_unlock(&q->lock);
     }
 
-    return item;
+    return n;
 }
 
 /**
- * Put an element at the tail of the queue in case the
- * queue is not full.
+ * Put up to count elements at the tail of the queue in
+ * case the queue is not full.
  * 
  * @param   q       The queue to enqueue into.
- * @param   item    The item to enqueue.
- * 
- * @return  0       Successfully enqueued item.
- * @return  -1      q is NULL.
- * @return  -1      q is full and non blocking.
+ * @param   items   The elements to enqueue.
+ * @param   count   Number of elements to enqueue.
+ * @param   block   Wait for space if the queue is full.
  * 
- * NOTE: This function blocks in case the queue is full.
+ * @return  n       The number of elements enqueued.
+ * @return  0       q is NULL.
+ * @return  0       q is full and non blocking.
+ * @return  0       q is closed.
  */
-int
-cirq_put(cirq *q, void *item)
+static uint64_t
+_cirq_put(cirq *q, void **items, uint64_t count, int block)
 {
-    int ret = -1;
+    uint64_t n = 0, i;
     uint64_t q_full;
 
-    if (!q) {
-        return -1;
+    if (!q || !count) {
+        return 0;
+    }
+
+    if (q->type == CIRQ_LOCKFREE_SPSC) {
+        return _cirq_spsc_put(q, items, count, block);
+    } else if (q->type == CIRQ_LOCKFREE_MPMC) {
+        return _cirq_mpmc_put(q, items, count, block);
     }
 
     // Acquire mutex if required.
-    if (q->type > CIRQ_SINGLE_THREAD) {
+    if (CIRQ_IS_LOCKING(q)) {
         pthread_mutex_lock(&q->lock);
     }
 
+    if (q->closed) {
+        goto release_mutex;
+    }
+
     q_full = (q->tail + 1) % q->len;
     q_full = (q_full == q->head)? 1: 0;
 
     if (q_full) {
-        if (q->type != CIRQ_LOCKING_AND_BLOCKING) {
+        if (!block) {
             goto release_mutex;
         }
         
         // The producer will go to sleep until a
         // signal wakes it. It needs to confirm on
         // wake that indeed the queue is no longer
-        // full;
+        // full, or that it has been closed.
         do {
-            pthread_cond_wait(&q->cond, &q->lock);
+            pthread_cond_wait(&q->not_full, &q->lock);
             q_full = (q->tail + 1) % q->len;
             q_full = (q_full == q->head)? 1: 0;
-        } while (q_full);
+        } while (q_full && !q->closed);
+
+        if (q->closed) {
+            goto release_mutex;
+        }
     }
 
-    q->store[q->tail] = item;
-    q->tail = (q->tail + 1) % q->len;
-    ret = 0;
+    while (n < count && (q->tail + 1) % q->len != q->head) {
+        q->store[q->tail] = items[n++];
+        q->tail = (q->tail + 1) % q->len;
+    }
 
-    // Signal any consumers waiting on this condition.
-    // Has no effect if nothing is waiting. This signal
-    // can be sent even though the current thread own the
-    // mutex [pthread_cond_signal man page].
+    // Signal as many consumers waiting on the queue to no
+    // longer be empty as there are new elements. Has no
+    // effect if nothing is waiting. This signal can be sent
+    // even though the current thread own the mutex
+    // [pthread_cond_signal man page].
     if (q->type == CIRQ_LOCKING_AND_BLOCKING) {
-        pthread_cond_signal(&q->cond);        
+        for (i = 0; i < n; i++) {
+            pthread_cond_signal(&q->not_empty);
+        }
     }
 
 release_mutex:
-    if (q->type > CIRQ_SINGLE_THREAD) {
+    if (CIRQ_IS_LOCKING(q)) {
+        pthread_mutex_unlock(&q->lock);
+    }
+
+    return n;
+}
+
+/**
+ * Acquire the element at the head of the circular queue
+ * in case the queue is not empty.
+ * 
+ * @param   q       The queue to dequeue from.
+ * 
+ * @return  item    The item at head of queue.
+ * @return  NULL    q is NULL.
+ * @return  NULL    q is empty and non blocking.
+ * @return  NULL    q is empty and closed.
+ * 
+ * NOTE: This function blocks in case the queue is empty.
+ */
+void*
+cirq_get(cirq *q)
+{
+    void *item;
+
+    if (!_cirq_get(q, &item, 1, q && q->type >= CIRQ_LOCKING_AND_BLOCKING)) {
+        return NULL;
+    }
+
+    return item;
+}
+
+/**
+ * Acquire the element at the head of the circular queue
+ * in case the queue is not empty, without ever blocking.
+ * 
+ * @param   q       The queue to dequeue from.
+ * 
+ * @return  item    The item at head of queue.
+ * @return  NULL    q is NULL.
+ * @return  NULL    q is empty.
+ */
+void*
+cirq_try_get(cirq *q)
+{
+    void *item;
+
+    if (!_cirq_get(q, &item, 1, 0)) {
+        return NULL;
+    }
+
+    return item;
+}
+
+/**
+ * Acquire up to count elements at the head of the circular
+ * queue under a single lock round trip or atomic operation.
+ * 
+ * @param   q       The queue to dequeue from.
+ * @param   items   Array to store the elements in.
+ * @param   count   Maximum number of elements to dequeue.
+ * 
+ * @return  n       The number of elements dequeued.
+ * @return  0       q is NULL.
+ * @return  0       q is empty and non blocking.
+ * @return  0       q is empty and closed.
+ * 
+ * NOTE: This function blocks until at least one element is
+ * available in case the queue is empty.
+ */
+uint64_t
+cirq_get_many(cirq *q, void **items, uint64_t count)
+{
+    return _cirq_get(q, items, count, q && q->type >= CIRQ_LOCKING_AND_BLOCKING);
+}
+
+/**
+ * Acquire up to count elements at the head of the circular
+ * queue, without ever blocking.
+ * 
+ * @param   q       The queue to dequeue from.
+ * @param   items   Array to store the elements in.
+ * @param   count   Maximum number of elements to dequeue.
+ * 
+ * @return  n       The number of elements dequeued.
+ * @return  0       q is NULL.
+ * @return  0       q is empty.
+ */
+uint64_t
+cirq_try_get_many(cirq *q, void **items, uint64_t count)
+{
+    return _cirq_get(q, items, count, 0);
+}
+
+/**
+ * Put an element at the tail of the queue in case the
+ * queue is not full.
+ * 
+ * @param   q       The queue to enqueue into.
+ * @param   item    The item to enqueue.
+ * 
+ * @return  0       Successfully enqueued item.
+ * @return  -1      q is NULL.
+ * @return  -1      q is full and non blocking.
+ * @return  -1      q is closed.
+ * 
+ * NOTE: This function blocks in case the queue is full.
+ */
+int
+cirq_put(cirq *q, void *item)
+{
+    return (_cirq_put(q, &item, 1, q && q->type >= CIRQ_LOCKING_AND_BLOCKING))? 0: -1;
+}
+
+/**
+ * Put count elements at the tail of the queue. Every run of
+ * elements which fits into the queue is moved under a single
+ * lock round trip or atomic operation.
+ * 
+ * @param   q       The queue to enqueue into.
+ * @param   items   The elements to enqueue.
+ * @param   count   Number of elements to enqueue.
+ * 
+ * @return  n       The number of elements enqueued.
+ * @return  < count q is NULL, full and non blocking or closed.
+ * 
+ * NOTE: This function blocks until all elements are enqueued
+ * in case the queue is full.
+ */
+uint64_t
+cirq_put_many(cirq *q, void **items, uint64_t count)
+{
+    uint64_t n, total = 0;
+
+    while (total < count) {
+        n = _cirq_put(q, items + total, count - total,
+                      q && q->type >= CIRQ_LOCKING_AND_BLOCKING);
+        if (!n) {
+            break;
+        }
+        total += n;
+    }
+
+    return total;
+}
+
+/**
+ * Put as many of count elements at the tail of the queue as
+ * fit right now, without ever blocking.
+ * 
+ * @param   q       The queue to enqueue into.
+ * @param   items   The elements to enqueue.
+ * @param   count   Number of elements to enqueue.
+ * 
+ * @return  n       The number of elements enqueued.
+ * @return  0       q is NULL.
+ * @return  0       q is full.
+ * @return  0       q is closed.
+ */
+uint64_t
+cirq_try_put_many(cirq *q, void **items, uint64_t count)
+{
+    uint64_t n, total = 0;
+
+    while (total < count) {
+        n = _cirq_put(q, items + total, count - total, 0);
+        if (!n) {
+            break;
+        }
+        total += n;
+    }
+
+    return total;
+}
+
+/**
+ * Close the queue. Every thread blocked on the queue is
+ * woken up. Elements still in the queue can be drained by
+ * cirq_get, after which it returns NULL instead of blocking,
+ * while cirq_put fails right away.
+ * 
+ * @param   q   The queue to close.
+ */
+void
+cirq_close(cirq *q)
+{
+    if (CIRQ_IS_LOCKFREE(q)) {
+        __atomic_store_n(&q->closed, 1, __ATOMIC_SEQ_CST);
+        _cirq_lf_wake(&q->cons, INT_MAX);
+        _cirq_lf_wake(&q->prod, INT_MAX);
+        return;
+    }
+
+    if (CIRQ_IS_LOCKING(q)) {
+        pthread_mutex_lock(&q->lock);
+    }
+
+    q->closed = 1;
+    if (q->type == CIRQ_LOCKING_AND_BLOCKING) {
+        pthread_cond_broadcast(&q->not_empty);
+        pthread_cond_broadcast(&q->not_full);
+    }
+
+    if (CIRQ_IS_LOCKING(q)) {
         pthread_mutex_unlock(&q->lock);
     }
+}
+
+/**
+ * Allow or forbid the lock-free variants to spin before they
+ * sleep. Spinning is pointless, and worse, if both sides of the
+ * queue share a single CPU, as the side spinning holds up the
+ * one it waits for.
+ * 
+ * @param   q       The queue.
+ * @param   spin    Spinning is allowed.
+ */
+void
+cirq_set_spin(cirq *q, uint8_t spin)
+{
+    q->spin = (spin && sysconf(_SC_NPROCESSORS_ONLN) > 1)? CIRQ_SPIN_COUNT: 0;
+}
 
-    return ret;
-}
\ No newline at end of file
+/**
+ * Check whether the queue has been closed. Only the flag is
+ * read, so threads can poll it on every iteration without
+ * contending on the queue.
+ * 
+ * @param   q   The queue to check.
+ * 
+ * @return  1   q is closed.
+ * @return  0   q is open.
+ */
+uint8_t
+cirq_closed(cirq *q)
+{
+    return __atomic_load_n(&q->closed, __ATOMIC_ACQUIRE);
+}
@@ -15,18 +15,59 @@
 #ifndef _CIRQ_H_
 #define _CIRQ_H_
 
+// Size of a cache line, used to keep the two sides of the
+// lock-free queues from sharing one.
+#define CIRQ_CACHE_LINE     64
+
 enum {
     CIRQ_SINGLE_THREAD,
     CIRQ_LOCKING,
-    CIRQ_LOCKING_AND_BLOCKING
+    CIRQ_LOCKING_AND_BLOCKING,
+
+    // A single producer and a single consumer thread. The
+    // queue length is rounded up to a power of two. Lock-free
+    // queues block like CIRQ_LOCKING_AND_BLOCKING.
+    CIRQ_LOCKFREE_SPSC,
+
+    // Any number of producer and consumer threads. Every slot
+    // carries a sequence number telling which lap of the queue
+    // it is ready for.
+    CIRQ_LOCKFREE_MPMC
 };
 
+/*
+ * One side (producer or consumer) of a lock-free queue. For
+ * a single producer and consumer the index is only ever written
+ * by its own side, and the index last seen of the other side is
+ * cached so that it only needs to be reloaded once the queue
+ * looks full or empty. Otherwise threads of a side claim
+ * indices with a compare and swap.
+ * 
+ * Threads which cannot make progress sleep on the event futex
+ * of their side. The other side only bumps the event and enters
+ * the kernel if the count of sleepers is non zero.
+ */
+struct cirq_side {
+    uint64_t index;
+    uint64_t cached;
+    uint32_t event;
+    uint32_t sleepers;
+} __attribute__((aligned(CIRQ_CACHE_LINE)));
+
 typedef struct cirq {
     pthread_mutex_t lock;
-    pthread_cond_t cond;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
     uint64_t len, head, tail;
     uint8_t type;
+    uint8_t closed;
     void **store;
+
+    // Lock-free variants.
+    uint64_t mask;
+    uint32_t spin;
+    uint64_t *seq;
+    struct cirq_side cons, prod;
 } cirq;
 
 /**
@@ -51,6 +92,30 @@ cirq_free(cirq *q);
 void*
 cirq_get(cirq *q);
 
+/**
+ * Acquire the element at the head of the circular queue
+ * in case the queue is not empty, without ever blocking.
+ */
+void*
+cirq_try_get(cirq *q);
+
+/**
+ * Acquire up to count elements at the head of the circular
+ * queue under a single lock round trip or atomic operation.
+ * 
+ * NOTE: This function blocks until at least one element is
+ * available in case the queue is empty.
+ */
+uint64_t
+cirq_get_many(cirq *q, void **items, uint64_t count);
+
+/**
+ * Acquire up to count elements at the head of the circular
+ * queue, without ever blocking.
+ */
+uint64_t
+cirq_try_get_many(cirq *q, void **items, uint64_t count);
+
 /**
  * Put an element at the tail of the queue in case the
  * queue is not full.
@@ -60,4 +125,43 @@ cirq_get(cirq *q);
 int
 cirq_put(cirq *q, void *item);
 
+/**
+ * Put count elements at the tail of the queue. Every run of
+ * elements which fits into the queue is moved under a single
+ * lock round trip or atomic operation.
+ * 
+ * NOTE: This function blocks until all elements are enqueued
+ * in case the queue is full.
+ */
+uint64_t
+cirq_put_many(cirq *q, void **items, uint64_t count);
+
+/**
+ * Put as many of count elements at the tail of the queue as
+ * fit right now, without ever blocking.
+ */
+uint64_t
+cirq_try_put_many(cirq *q, void **items, uint64_t count);
+
+/**
+ * Close the queue, waking every thread blocked on it.
+ * Elements still in the queue may be drained but no new
+ * elements are accepted.
+ */
+void
+cirq_close(cirq *q);
+
+/**
+ * Allow or forbid the lock-free variants to spin before they
+ * sleep.
+ */
+void
+cirq_set_spin(cirq *q, uint8_t spin);
+
+/**
+ * Check whether the queue has been closed.
+ */
+uint8_t
+cirq_closed(cirq *q);
+
 #endif
\ No newline at end of file
@@ -1,33 +1,79 @@
 #include "expdistrib.h"
-
-/**
- * Get a uniformly distributed number between 0 and 1.
- */
-static double
-get_uniform_variate(void)
-{
-    unsigned int random_number;
-    double variate;
-
-    random_number = rand();
-    variate = (double)random_number / (double)RAND_MAX;
-
-    return variate;
-}
+#include <string.h>
 
 /**
  * Acquire a negative exponential distribution of
  * for a specified interval lambda upon a chain of 
  * calls to the function.
+ * 
+ * The uniform variate is drawn from the calling thread's own
+ * generator and never 0, so the result is always finite.
  */
 double
-get_exponential_variate(double rate)
+get_exponential_variate(rng *r, double rate)
 {
     double exp_variate;
     double variate;
 
-    variate = get_uniform_variate();
+    variate = rng_uniform(r);
     exp_variate = log(variate) / -rate;
 
     return exp_variate;
-}
\ No newline at end of file
+}
+
+/**
+ * Natural logarithm of a positive, normal double without any
+ * branches or calls, so that a loop over it vectorizes. The
+ * argument is split into 2^k * m with m in [sqrt(1/2), sqrt(2))
+ * using integer arithmetic on its bits alone, and log(m) is
+ * summed from the series of 2 * atanh(s) with s = (m - 1) / (m + 1).
+ * With |s| < 0.172 the series is cut where the relative error
+ * drops below 1e-12.
+ */
+static inline double
+_fast_log(double x)
+{
+    uint64_t bits, kbits;
+    int64_t tmp;
+    double m, k, s, s2;
+
+    memcpy(&bits, &x, sizeof bits);
+    tmp = (int64_t)(bits - 0x3fe6a09e667f3bcdULL);
+
+    // Exponent of the reduced argument as a double, using the
+    // 1.5 * 2^52 trick to avoid an integer conversion.
+    kbits = 0x4338000000000000ULL + (uint64_t)(tmp >> 52);
+    memcpy(&k, &kbits, sizeof k);
+    k -= 6755399441055744.0;
+
+    bits -= (uint64_t)tmp & 0xfff0000000000000ULL;
+    memcpy(&m, &bits, sizeof m);
+
+    s = (m - 1.0) / (m + 1.0);
+    s2 = s * s;
+
+    return k * M_LN2 + s * (2.0 + s2 * (2.0 / 3 + s2 * (2.0 / 5 + s2 * (2.0 / 7 +
+           s2 * (2.0 / 9 + s2 * (2.0 / 11 + s2 * (2.0 / 13 + s2 * (2.0 / 15))))))));
+}
+
+/**
+ * Fill an array with negative exponential variates for the
+ * specified rate. The uniform variates are drawn first, after
+ * which a single branch free pass turns them into exponential
+ * ones, which the compiler can run on vector registers.
+ */
+void
+get_exponential_variates(rng *r, double rate, double *variates, uint64_t count)
+{
+    double scale;
+    uint64_t i;
+
+    for (i = 0; i < count; i++) {
+        variates[i] = rng_uniform(r);
+    }
+
+    scale = -1.0 / rate;
+    for (i = 0; i < count; i++) {
+        variates[i] = _fast_log(variates[i]) * scale;
+    }
+}
@@ -11,9 +11,11 @@
  * Note: The algorithm for obtaining an exponential distribution
  * was obtained from Wikipedia.
  */
+#include "../rng/rng.h"
 #include <math.h>
 #include <stdlib.h>
 #include <time.h>
+#include <stdint.h>
 
 #ifndef _EXPDISTRIB_H_
 #define _EXPDISTRIB_H_
@@ -24,6 +26,13 @@
  * calls to the function.
  */
 double 
-get_exponential_variate(double lambda);
+get_exponential_variate(rng *r, double lambda);
+
+/**
+ * Fill an array with count negative exponential variates
+ * for a specified interval lambda in one pass.
+ */
+void
+get_exponential_variates(rng *r, double lambda, double *variates, uint64_t count);
 
 #endif
\ No newline at end of file
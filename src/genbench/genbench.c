@@ -0,0 +1,104 @@
+/**
+ * Microbenchmark for workload generation. It measures how many
+ * work items per second the producer can generate, one item at
+ * a time with libm's log as before, with the gaps in blocks out
+ * of the vectorized exponential kernel, and with the items in
+ * blocks as well, as the producer does now.
+ *
+ * Usage: genbench [ITEMS]
+ *
+ * Author: Yash Gupta <yash_gupta12@live.com>
+ * Copyright: Yash Gupta
+ *
+ * License: MIT Public License
+ */
+#include "../expdistrib/expdistrib.h"
+#include "../nano_time.h"
+#include "../work_profile.h"
+#include "../model.h"
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+// Count of items generated at once, as in the producer.
+#define BLOCK           256
+
+// Drive size offsets are drawn against.
+#define DRIVE_SIZE      (4ULL << 40)
+
+int
+main(int argc, char *argv[])
+{
+    struct work_profile profile;
+    struct work_pool *pool;
+    struct work_item *items[BLOCK];
+    double gaps[BLOCK], sum;
+    uint64_t count, done, i, t;
+    int64_t scalar, gap, block;
+    struct work_generator gen;
+
+    count = (argc > 1)? strtoull(argv[1], NULL, 0): 10000000;
+    nano_time_init();
+
+    work_profile_init(&profile);
+    work_profile_add(&profile, "rread", 0, ACCESS_RANDOM, 25, 4096);
+    work_profile_add(&profile, "rwrite", 1, ACCESS_RANDOM, 25, 4096);
+    work_profile_add(&profile, "sread", 0, ACCESS_SEQUENTIAL, 25, 65536);
+    work_profile_add(&profile, "swrite", 1, ACCESS_SEQUENTIAL, 25, 65536);
+    work_profile_finish(&profile);
+    profile.align = 4096;
+
+    pool = _work_pool_create(BLOCK, CIRQ_SINGLE_THREAD);
+    assert(pool);
+    for (i = 0; i < BLOCK; i++) {
+        items[i] = &pool->slab[i];
+    }
+
+    // One gap and one item at a time.
+    _work_generator_init(&gen, &profile, 0, DRIVE_SIZE);
+    rng_seed(&gen.rng, 1);
+    sum = 0;
+    INIT_TIME(&t);
+    for (done = 0; done < count; done++) {
+        sum += get_exponential_variate(&gen.rng, 100000);
+        _generate_work_item(items[done % BLOCK], &profile, DRIVE_SIZE, &gen);
+    }
+    scalar = GET_TIME(t);
+    printf("scalar: %.1lf M items/s (mean gap %.3lf us)\n",
+           count / (scalar / 1000.0), sum / count * 1000000);
+
+    // Gaps in blocks, items one at a time.
+    _work_generator_init(&gen, &profile, 0, DRIVE_SIZE);
+    rng_seed(&gen.rng, 1);
+    sum = 0;
+    INIT_TIME(&t);
+    for (done = 0; done < count; done += BLOCK) {
+        get_exponential_variates(&gen.rng, 100000, gaps, BLOCK);
+        for (i = 0; i < BLOCK; i++) {
+            _generate_work_item(items[i], &profile, DRIVE_SIZE, &gen);
+            sum += gaps[i];
+        }
+    }
+    gap = GET_TIME(t);
+    printf("gaps:   %.1lf M items/s (mean gap %.3lf us)\n",
+           done / (gap / 1000.0), sum / done * 1000000);
+
+    // Gaps and items in blocks.
+    _work_generator_init(&gen, &profile, 0, DRIVE_SIZE);
+    rng_seed(&gen.rng, 1);
+    sum = 0;
+    INIT_TIME(&t);
+    for (done = 0; done < count; done += BLOCK) {
+        get_exponential_variates(&gen.rng, 100000, gaps, BLOCK);
+        _generate_work_items(items, BLOCK, &profile, DRIVE_SIZE, &gen);
+        for (i = 0; i < BLOCK; i++) {
+            sum += gaps[i];
+        }
+    }
+    block = GET_TIME(t);
+    printf("block:  %.1lf M items/s (mean gap %.3lf us)\n",
+           done / (block / 1000.0), sum / done * 1000000);
+
+    _work_pool_free(pool);
+    return 0;
+}
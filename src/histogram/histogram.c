@@ -0,0 +1,171 @@
+/**
+ * Source file for a fixed size, log-linear latency histogram
+ * in C. Recording a value is O(1) and never allocates, so a
+ * histogram can be kept per thread inside the timed loop and
+ * merged with others once the run is over.
+ *
+ * Author: Yash Gupta <yash_gupta12@live.com>
+ * Copyright: Yash Gupta
+ *
+ * License: MIT Public License
+ */
+#include "histogram.h"
+#include <string.h>
+
+#define HALF_SUB_BUCKETS    (HISTOGRAM_SUB_BUCKETS / 2)
+
+/**
+ * Map a value to the index of its bucket. Values below
+ * HISTOGRAM_SUB_BUCKETS have a bucket each. Above that, the
+ * value is shifted right until only its top HISTOGRAM_SUB_BITS
+ * bits remain, and the shift selects the group of buckets.
+ *
+ * @param   value   The value to map.
+ *
+ * @return  index   Index of the bucket holding value.
+ */
+static uint32_t
+_histogram_index(uint64_t value)
+{
+    uint32_t shift;
+
+    if (value < HISTOGRAM_SUB_BUCKETS) {
+        return value;
+    }
+
+    shift = 64 - __builtin_clzll(value) - HISTOGRAM_SUB_BITS;
+    if (shift > HISTOGRAM_MAX_BITS - HISTOGRAM_SUB_BITS) {
+        return HISTOGRAM_BUCKETS - 1;
+    }
+
+    return (shift + 1) * HALF_SUB_BUCKETS + (value >> shift) - HALF_SUB_BUCKETS;
+}
+
+/**
+ * Map a bucket index back to the largest value it holds.
+ *
+ * @param   index   Index of the bucket.
+ *
+ * @return  value   Largest value mapped to index.
+ */
+static uint64_t
+_histogram_value(uint32_t index)
+{
+    uint32_t shift;
+    uint64_t sub;
+
+    if (index < HISTOGRAM_SUB_BUCKETS) {
+        return index;
+    }
+
+    shift = index / HALF_SUB_BUCKETS - 1;
+    sub = index % HALF_SUB_BUCKETS + HALF_SUB_BUCKETS;
+
+    return ((sub + 1) << shift) - 1;
+}
+
+/**
+ * Reset a histogram to hold no values.
+ *
+ * @param   h   The histogram to reset.
+ */
+void
+histogram_init(histogram *h)
+{
+    memset(h, 0, sizeof *h);
+    h->min = UINT64_MAX;
+}
+
+/**
+ * Record a single value in a histogram.
+ *
+ * @param   h       The histogram to record in.
+ * @param   value   The value to record.
+ */
+void
+histogram_record(histogram *h, uint64_t value)
+{
+    h->buckets[_histogram_index(value)]++;
+    h->count++;
+    if (value < h->min) {
+        h->min = value;
+    }
+    if (value > h->max) {
+        h->max = value;
+    }
+}
+
+/**
+ * Add every value recorded in src to dst.
+ *
+ * @param   dst     The histogram to merge into.
+ * @param   src     The histogram to merge from.
+ */
+void
+histogram_merge(histogram *dst, histogram *src)
+{
+    uint32_t i;
+
+    for (i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        dst->buckets[i] += src->buckets[i];
+    }
+
+    dst->count += src->count;
+    if (src->min < dst->min) {
+        dst->min = src->min;
+    }
+    if (src->max > dst->max) {
+        dst->max = src->max;
+    }
+}
+
+/**
+ * Acquire the value below which the specified percentage of
+ * the recorded values fall. The value reported is the upper
+ * bound of the bucket the percentile lands in, clamped to the
+ * exact minimum and maximum recorded.
+ *
+ * @param   h           The histogram to query.
+ * @param   percentile  Percentage in the range [0, 100].
+ *
+ * @return  value       The value at percentile.
+ * @return  0           No values were recorded.
+ */
+uint64_t
+histogram_percentile(histogram *h, double percentile)
+{
+    uint64_t target, seen, value;
+    uint32_t i;
+
+    if (!h->count) {
+        return 0;
+    }
+    if (percentile <= 0) {
+        return h->min;
+    }
+
+    target = (uint64_t)((percentile / 100.0) * h->count + 0.5);
+    if (target < 1) {
+        target = 1;
+    }
+    if (target > h->count) {
+        target = h->count;
+    }
+
+    for (i = 0, seen = 0; i < HISTOGRAM_BUCKETS; i++) {
+        seen += h->buckets[i];
+        if (seen >= target) {
+            break;
+        }
+    }
+
+    value = _histogram_value(i);
+    if (value < h->min) {
+        value = h->min;
+    }
+    if (value > h->max) {
+        value = h->max;
+    }
+
+    return value;
+}
@@ -0,0 +1,62 @@
+/**
+ * Header file for a fixed size, log-linear latency histogram
+ * in C. Recording a value is O(1) and never allocates, so a
+ * histogram can be kept per thread inside the timed loop and
+ * merged with others once the run is over.
+ *
+ * Author: Yash Gupta <yash_gupta12@live.com>
+ * Copyright: Yash Gupta
+ *
+ * License: MIT Public License
+ */
+#include <stdlib.h>
+#include <stdint.h>
+
+#ifndef _HISTOGRAM_H_
+#define _HISTOGRAM_H_
+
+/*
+ * Values are bucketed by their most significant bits. Each
+ * power of two range is split into HISTOGRAM_SUB_BUCKETS / 2
+ * linear buckets, which bounds the relative error of any value
+ * reported to 1 / (HISTOGRAM_SUB_BUCKETS / 2), i.e. under 2%.
+ * Values up to 2^HISTOGRAM_MAX_BITS are tracked (over 18
+ * minutes in nanoseconds), anything larger is clamped.
+ */
+#define HISTOGRAM_SUB_BITS      7
+#define HISTOGRAM_SUB_BUCKETS   (1 << HISTOGRAM_SUB_BITS)
+#define HISTOGRAM_MAX_BITS      40
+#define HISTOGRAM_BUCKETS       ((HISTOGRAM_MAX_BITS - HISTOGRAM_SUB_BITS + 2) * (HISTOGRAM_SUB_BUCKETS / 2))
+
+typedef struct histogram {
+    uint64_t count;
+    uint64_t min, max;
+    uint64_t buckets[HISTOGRAM_BUCKETS];
+} histogram;
+
+/**
+ * Reset a histogram to hold no values.
+ */
+void
+histogram_init(histogram *h);
+
+/**
+ * Record a single value in a histogram.
+ */
+void
+histogram_record(histogram *h, uint64_t value);
+
+/**
+ * Add every value recorded in src to dst.
+ */
+void
+histogram_merge(histogram *dst, histogram *src);
+
+/**
+ * Acquire the value below which the specified percentage of
+ * the recorded values fall.
+ */
+uint64_t
+histogram_percentile(histogram *h, double percentile);
+
+#endif
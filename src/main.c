@@ -8,11 +8,19 @@
  * 
  * License: MIT Public License
  */
+#define _GNU_SOURCE
 #include "expdistrib/expdistrib.h"
+#include "pacer/pacer.h"
+#include "trace/trace.h"
 #include "cirq/cirq.h"
+#include "uring/uring.h"
+#include "bufpool/bufpool.h"
+#include "affinity/affinity.h"
 #include "nano_time.h"
 #include "work_profile.h"
 #include "model.h"
+#include "script/script.h"
+#include "search/search.h"
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
@@ -24,6 +32,12 @@
 #include <pthread.h>
 #include <time.h>
 #include <fcntl.h>
+#include <getopt.h>
+#include <stddef.h>
+#include <sched.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <linux/fs.h>
 
 //
 // Macros
@@ -31,6 +45,46 @@
 // Workload Queue Count
 #define MAX_CIRQ_LEN    64
 
+#define MAX(a, b)       (((a) > (b))? (a): (b))
+
+// Count of latency percentiles reported for every task.
+#define LATENCY_POINTS  7
+
+// Largest batch of items moved through a queue at once.
+#define MAX_BATCH       32
+
+// Count of inter-arrival gaps generated at once.
+#define GAP_BLOCK       256
+
+// Count of sequential streams per direction told apart
+// when importing a text trace.
+#define IMPORT_STREAMS  16
+
+// Upper bound on how long the io_uring engine waits for a
+// completion before checking the workload queue again.
+#define URING_POLL_NS   20000
+
+// Lead given to the threads of every pipeline to start up
+// before the common clock starts.
+#define START_LEAD_NS   10000000
+
+// Name of the statistics files of the whole run when more than
+// one drive is benchmarked.
+#define AGGREGATE_NAME  "aggregate"
+#define AGGREGATE_TIMELINE  "aggregate.csv"
+
+// Fraction of the arrivals at a rate the drives have to complete
+// for the rate to count as sustained by a saturation search.
+#define SEARCH_KEEP_UP  0.99
+
+// Seconds the timeline of a run covers beyond its duration, so
+// that requests completed after the run stopped still fit.
+#define TIMELINE_SLACK  2
+
+// Placement of the workers of a drive on NUMA nodes.
+#define NUMA_NONE       -1
+#define NUMA_AUTO       -2
+
 //
 // Enumerations
 //
@@ -57,37 +111,328 @@ enum bench_args_enum {
     ARG_COUNT
 };
 
-enum consumer_state {
-    CONSUMER_STATE_INIT = 0,
-    CONSUMER_STATE_IN_LOOP,
-    CONSUMER_STATE_EXIT_LOOP,
-    CONSUMER_STATE_EXITED_LOOP
+// Roles of the threads of a run.
+enum thread_role {
+    ROLE_PRODUCER = 0,
+    ROLE_CONSUMER,
+    ROLE_TIMER,
+    ROLE_COUNT
 };
 
 //
 // Global Variables
 //
-// Exit variable for consumer thread.
-volatile uint8_t global_cstate = CONSUMER_STATE_INIT;
+// Latency percentiles reported for every task.
+static const double percentiles[LATENCY_POINTS] = {0, 50, 90, 99, 99.9, 99.99, 100};
+
+// Names of the classes of the default profile, by IO_* index.
+static const char *default_classes[IO_MAX_TASKS] = {"rread", "rwrite", "sread", "swrite"};
+
 
 //
 // Structures
 //
 // All required arguments
 struct bench_args {
-    uint8_t     prob[4];
+    double      prob[4];
     uint64_t    sz[4];
     long int    timer;
     double      lambda;
     char *      path;
+
+    // Optional.
+    enum io_engine  engine;
+    uint32_t        iodepth;
+    uint32_t        consumers;
+    uint8_t         lockfree;
+    uint8_t         fixed;
+    uint8_t         verbose;
+    uint8_t         direct;
+    uint8_t         hugepages;
+    uint8_t         per_core;
+    int32_t         numa;
+    uint8_t         role_pinned[ROLE_COUNT];
+    cpu_set_t       role_cpus[ROLE_COUNT];
+    uint64_t        seed;
+    char *          profile;
+    char *          arrival;
+    char *          script;
+    char *          search;
+    char *          slo;
+    char *          compile;
+    char *          replay;
+    char *          import;
+    double          speed;
+};
+
+// Block of precomputed inter-arrival gaps.
+struct gap_block {
+    double gaps[GAP_BLOCK];
+    uint32_t next;
 };
 
+// Per request state of the io_uring engine.
+struct uring_slot {
+    struct work_item *item;
+    uint64_t ttoken;
+};
+
+/**
+ * Add a single request to a set of statistics.
+ * 
+ * @param   data        The statistics.
+ * @param   length      Length of the request.
+ * @param   tstamp      Service time in nanoseconds.
+ * @param   response    Response time in nanoseconds.
+ */
+static inline void
+_cwork_record(struct data_collection *data, uint64_t length, int64_t tstamp, int64_t response)
+{
+    data->total_time_consumed += tstamp;
+    data->total_operations += 1;
+    data->total_bytes += length;
+    histogram_record(&data->service, tstamp);
+    histogram_record(&data->queueing, response - tstamp);
+    histogram_record(&data->response, response);
+}
+
+/**
+ * Account for a single completed work item in the consumer
+ * statistics of its phase, both of its class and of its size
+ * bucket, and in the second of the timeline it completed in.
+ * The item is returned to the work item pool by the caller,
+ * together with the rest of its batch.
+ * 
+ * Whatever part of the time since the intended arrival of the
+ * item was not spent on the I/O itself was spent queueing. The
+ * overhead of taking the time stamps is not part of the I/O.
+ * 
+ * @param   cargs   Consumer specific arguments.
+ * @param   item    The completed work item.
+ * @param   tstamp  Time taken by the I/O in nanoseconds.
+ */
+static void
+_cwork_complete(struct thread_args_consumer *cargs, struct work_item *item, int64_t tstamp)
+{
+    struct data_collection *data;
+    uint32_t classes;
+    int64_t response;
+
+    tstamp -= nano_time_source.overhead;
+    if (tstamp < 0) {
+        tstamp = 0;
+    }
+    response = GET_TIME(item->arrival);
+    if (response < tstamp) {
+        response = tstamp;
+    }
+
+    data = &cargs->data[cargs->bases[item->phase]];
+    classes = cargs->bases[item->phase + 1] - cargs->bases[item->phase] - SIZE_STATS;
+    _cwork_record(&data[item->task], item->length, tstamp, response);
+    _cwork_record(&data[_size_bucket(classes, item->write, item->length)], item->length, tstamp, response);
+    timeline_recorder_record(cargs->recorder, item->arrival + response, item->length, response);
+    if (cargs->verbose) {
+        printf("%lu. Time Taken: %.8lf seconds\n\n", item->sequence, tstamp / 1000000000.0);
+    }
+}
+
+/**
+ * The synchronous engine issues a single blocking pread or
+ * pwrite at a time. The device never sees more than one
+ * outstanding request from this consumer, so a single buffer
+ * from the pool is reused for every request.
+ * 
+ * Items are dequeued and returned to the pool in batches of up
+ * to cargs->batch. Only a lone consumer should batch, otherwise
+ * it would hold on to items other consumers could be issuing.
+ * 
+ * @param   cargs   Consumer specific arguments.
+ */
+static void
+_cwork_sync(struct thread_args_consumer *cargs)
+{
+    struct work_item *batch[MAX_BATCH];
+    struct work_item *item;
+    uint64_t ttoken;
+    int64_t tstamp;
+    void *buf;
+    uint64_t ret, n, i;
+
+    buf = bufpool_get(cargs->buffers, cargs->buf_base);
+    assert(buf != NULL);
+
+    while (!cirq_closed(cargs->workload)) {
+        n = cirq_get_many(cargs->workload, (void**)batch, cargs->batch);
+        if (!n) {
+            break;
+        }
+
+        for (i = 0; i < n; i++) {
+            item = batch[i];
+            if (cargs->verbose) {
+                printf("%lu. O: %lu | L: %lu | T: %d\n",
+                item->sequence, item->offset, item->length, item->task);
+            }
+
+            if (!item->write) {
+                INIT_TIME(&ttoken);
+                ret = pread(cargs->fd, buf, item->length, item->offset);
+                tstamp = GET_TIME(ttoken);
+            } else {
+                INIT_TIME(&ttoken);
+                ret = pwrite(cargs->fd, buf, item->length, item->offset);
+                tstamp = GET_TIME(ttoken);
+            }
+            assert(ret == item->length);
+
+            _cwork_complete(cargs, item, tstamp);
+        }
+
+        cirq_put_many(cargs->items->free, (void**)batch, n);
+    }
+}
+
+/**
+ * The io_uring engine keeps up to iodepth requests in flight.
+ * New requests are only waited upon when nothing is outstanding,
+ * otherwise completions are reaped in batches and the workload
+ * queue is polled in between. Items move in and out of the
+ * queues in batches as well. Every request is timed from its
+ * submission to the reaping of its completion.
+ * 
+ * @param   cargs   Consumer specific arguments.
+ */
+static void
+_cwork_uring(struct thread_args_consumer *cargs)
+{
+    struct uring_slot *slots;
+    struct io_uring_cqe *cqes;
+    struct io_uring_sqe *sqe;
+    struct work_item *item, **batch;
+    struct iovec *iov;
+    uint32_t *free_slots, *pending;
+    uint32_t depth, nfree, npending, inflight, slot, i, n;
+    uring *ring;
+    int ret;
+
+    depth = cargs->iodepth;
+    ring = uring_create(depth);
+    assert(ring != NULL);
+
+    slots = malloc(sizeof(*slots) * depth);
+    cqes = malloc(sizeof(*cqes) * depth);
+    iov = malloc(sizeof(*iov) * depth);
+    free_slots = malloc(sizeof(*free_slots) * depth);
+    pending = malloc(sizeof(*pending) * depth);
+    batch = malloc(sizeof(*batch) * depth);
+    assert(slots && cqes && iov && free_slots && pending && batch);
+
+    /*
+     * Every slot owns a buffer from the pool for the lifetime
+     * of the run so that nothing is allocated per request. With
+     * fixed buffers and files the kernel is also spared the page
+     * pinning and file lookup on every request.
+     */
+    for (i = 0; i < depth; i++) {
+        iov[i].iov_base = bufpool_get(cargs->buffers, cargs->buf_base + i);
+        iov[i].iov_len = cargs->max_io_size;
+        assert(iov[i].iov_base != NULL);
+        free_slots[i] = depth - i - 1;
+    }
+    nfree = depth;
+
+    if (cargs->fixed) {
+        ret = uring_register_buffers(ring, iov, depth);
+        assert(ret == 0);
+        ret = uring_register_files(ring, &cargs->fd, 1);
+        assert(ret == 0);
+    }
+
+    inflight = 0;
+    while (!cirq_closed(cargs->workload) || inflight) {
+        // Take as many items as there are free slots in one go.
+        npending = 0;
+        if (!cirq_closed(cargs->workload) && nfree) {
+            n = (inflight)? cirq_try_get_many(cargs->workload, (void**)batch, nfree):
+                            cirq_get_many(cargs->workload, (void**)batch, nfree);
+        } else {
+            n = 0;
+        }
+
+        for (i = 0; i < n; i++) {
+            item = batch[i];
+            if (cargs->verbose) {
+                printf("%lu. O: %lu | L: %lu | T: %d\n",
+                item->sequence, item->offset, item->length, item->task);
+            }
+
+            slot = free_slots[--nfree];
+            slots[slot].item = item;
+
+            sqe = uring_get_sqe(ring);
+            assert(sqe != NULL);
+            if (!item->write) {
+                sqe->opcode = (cargs->fixed)? IORING_OP_READ_FIXED: IORING_OP_READ;
+            } else {
+                sqe->opcode = (cargs->fixed)? IORING_OP_WRITE_FIXED: IORING_OP_WRITE;
+            }
+            sqe->fd = (cargs->fixed)? 0: cargs->fd;
+            sqe->flags = (cargs->fixed)? IOSQE_FIXED_FILE: 0;
+            sqe->addr = (uint64_t)(uintptr_t)iov[slot].iov_base;
+            sqe->len = item->length;
+            sqe->off = item->offset;
+            sqe->buf_index = slot;
+            sqe->user_data = slot;
+
+            pending[npending++] = slot;
+            inflight++;
+        }
+
+        for (i = 0; i < npending; i++) {
+            INIT_TIME(&slots[pending[i]].ttoken);
+        }
+
+        // Wait indefinitely only if no further request could be
+        // queued anyway, otherwise come back for the queue.
+        ret = uring_submit(ring, (inflight)? 1: 0,
+                           (nfree && !cirq_closed(cargs->workload))? URING_POLL_NS: 0);
+        assert(ret >= 0);
+
+        n = uring_reap(ring, cqes, depth);
+        for (i = 0; i < n; i++) {
+            slot = cqes[i].user_data;
+            item = slots[slot].item;
+            assert(cqes[i].res >= 0 && (uint64_t)cqes[i].res == item->length);
+
+            _cwork_complete(cargs, item, GET_TIME(slots[slot].ttoken));
+            free_slots[nfree++] = slot;
+            batch[i] = item;
+            inflight--;
+        }
+        cirq_put_many(cargs->items->free, (void**)batch, n);
+    }
+
+    uring_free(ring);
+    free(batch);
+    free(pending);
+    free(free_slots);
+    free(iov);
+    free(cqes);
+    free(slots);
+}
+
 /**
  * The consumer work function is a brain dead work function
  * which performs the actual I/O to the disk drive. It acquires
  * a workload item from a circular queue and executes that
  * workload on a specified drive, collecting statistics.
  * 
+ * Any number of consumers may drain the same queue. Each of
+ * them keeps its own statistics which are merged once the
+ * run is over, while the seconds of the timeline are merged
+ * into that of the drive as the run goes on.
+ * 
  * @param   args    Consumer specific arguments.
  * @return  NULL
  */
@@ -95,350 +440,2126 @@ void*
 cwork(void *args)
 {
     struct thread_args_consumer *cargs = args;
-    struct work_item *item;
-    struct timespec ttoken;
-    double tstamp;
-    double total;
-    double rwrite_total, swrite_total;
-    void *buf;
-    char *ofile_name;
-    int fd;
-    uint64_t ret;
-    int64_t i;
+    uint32_t i;
 
-    for (i = 0; i < MAX_DATA_POINTS; i++) {
-        cargs->data[i].total_time_consumed = 0;
-        cargs->data[i].total_operations = 0;
+    // The statistics are allocated here so that they are
+    // faulted in close to the CPU of the consumer.
+    cargs->data = calloc(cargs->bases[cargs->phases], sizeof(*cargs->data));
+    assert(cargs->data != NULL);
+    for (i = 0; i < cargs->bases[cargs->phases]; i++) {
+        histogram_init(&cargs->data[i].service);
+        histogram_init(&cargs->data[i].queueing);
+        histogram_init(&cargs->data[i].response);
     }
-    lseek(cargs->fd, 0, SEEK_SET);
+    cargs->recorder = timeline_recorder_create(cargs->timeline);
+    assert(cargs->recorder != NULL);
 
     /*
      **********************************************************
-     * A global variable is used to signal this thread to
-     * exit its loop. This is because this thread needs to
-     * output its statistics to a file. 
+     * Closing the workload queue signals this thread to
+     * exit its loop. This is because the statistics of this
+     * thread need to be merged and written to a file.
      * 
-     * There is no need for a mutex as it is guarenteed that
-     * until this thread exits the loop, the producer thread
-     * will keep functioning. Hence, even if it spends another
-     * iteration in the loop due to a race condition, it hurts
-     * no one and avoids the overhead of a mutex.
-     * 
-     * It also signals the timer thread that it is indeed out
-     * of the loop and so it is safe to cancel the producer
-     * thread 
+     * The closed flag of the queue is only ever read, so
+     * checking it on every iteration costs next to nothing
+     * and nothing is shared with other pipelines. A consumer
+     * asleep on an empty queue is woken up and handed NULL, so
+     * even if it spends another iteration in the loop due to a
+     * race condition, it hurts no one and avoids the overhead
+     * of a mutex.
      **********************************************************
      */
 
-    total = rwrite_total = swrite_total = 0;
-    global_cstate = CONSUMER_STATE_IN_LOOP;
-    while (global_cstate == CONSUMER_STATE_IN_LOOP) {
-        item = cirq_get(cargs->workload);
+    if (cargs->engine == IO_ENGINE_URING) {
+        _cwork_uring(cargs);
+    } else {
+        _cwork_sync(cargs);
+    }
+    timeline_recorder_free(cargs->recorder);
 
-        printf("%lu. O: %lu | L: %lu | T: %d\n",
-        item->sequence, item->offset, item->length, item->task);
+    return NULL;
+}
 
-        buf = malloc(item->length);
-        assert(buf != NULL);
+/**
+ * Print the percentiles of one of the latency distributions of
+ * every task and write them to the statistics file.
+ * 
+ * @param   fd      Descriptor of the statistics file.
+ * @param   name    Name of the distribution.
+ * @param   data    Merged statistics of all consumers.
+ * @param   count   Count of classes.
+ * @param   offset  Offset of the histogram in struct data_collection.
+ */
+static void
+_output_latency(int fd, const char *name, struct data_collection *data, uint32_t count,
+                size_t offset)
+{
+    histogram *h;
+    double lat;
+    int64_t i;
+    int p;
 
-        if (item->task == IO_RREAD || item->task == IO_SREAD) {
-            INIT_TIME(&ttoken);
-            ret = pread(cargs->fd, buf, item->length, item->offset);
-            tstamp = GET_TIME(ttoken);
-        } else {
-            memset(buf, 49, item->length);
-            INIT_TIME(&ttoken);
-            ret = pwrite(cargs->fd, buf, item->length, item->offset);
-            tstamp = GET_TIME(ttoken);
+    for (i = 0; i < count; i++) {
+        h = (histogram*)((char*)&data[i] + offset);
+        printf("%ld. %-8s (us):", i, name);
+        for (p = 0; p < LATENCY_POINTS; p++) {
+            lat = histogram_percentile(h, percentiles[p]) / 1000000000.0;
+            printf(" p%g=%.1lf", percentiles[p], lat * 1000000.0);
+            write(fd, &lat, sizeof(double));
+        }
+        printf("\n");
+    }
+}
 
-            if (item->task == IO_RWRITE) {
-                rwrite_total += item->length;
-            } else {
-                swrite_total += item->length;
+/**
+ * Print the statistics of every size bucket which saw any
+ * requests and write those of every bucket to the statistics
+ * file, reads first.
+ * 
+ * @param   fd      Descriptor of the statistics file.
+ * @param   data    Statistics of the size buckets.
+ * @param   elapsed Length of the run in seconds.
+ */
+static void
+_output_sizes(int fd, struct data_collection *data, double elapsed)
+{
+    double avg, rate, lat;
+    uint64_t limit;
+    int64_t i;
+    int p;
+
+    for (i = 0; i < SIZE_STATS; i++) {
+        avg = (data[i].total_operations)?
+              (data[i].total_time_consumed / 1000000000.0) / data[i].total_operations: 0;
+        rate = (elapsed > 0)? data[i].total_bytes / elapsed: 0;
+
+        write(fd, &data[i].total_operations, sizeof(uint64_t));
+        write(fd, &data[i].total_bytes, sizeof(uint64_t));
+        write(fd, &avg, sizeof(double));
+        write(fd, &rate, sizeof(double));
+
+        limit = (1ULL << SIZE_BUCKET_SHIFT) << (i % SIZE_BUCKETS);
+        if (data[i].total_operations) {
+            printf("%-5s %s%4lu KiB: %lu ops, %.2lf MiB/s, avg %.1lf us, service (us):",
+                   (i < SIZE_BUCKETS)? "Read": "Write", (i % SIZE_BUCKETS == SIZE_BUCKETS - 1)? ">": "<=",
+                   ((i % SIZE_BUCKETS == SIZE_BUCKETS - 1)? limit / 2: limit) / 1024,
+                   data[i].total_operations, rate / 1048576.0, avg * 1000000.0);
+        }
+        for (p = 0; p < LATENCY_POINTS; p++) {
+            lat = histogram_percentile(&data[i].service, percentiles[p]) / 1000000000.0;
+            write(fd, &lat, sizeof(double));
+            if (data[i].total_operations) {
+                printf(" p%g=%.1lf", percentiles[p], lat * 1000000.0);
             }
         }
-        assert(ret == item->length);
+        if (data[i].total_operations) {
+            printf("\n");
+        }
+    }
+}
+
+/**
+ * Acquire the name of a statistics file of a drive.
+ * 
+ * @param   file_name   Path of the drive that was benchmarked.
+ * @param   suffix      Suffix of the statistics file.
+ * 
+ * @return  The name of the statistics file, to be freed.
+ */
+static char*
+_output_file_name(const char *file_name, const char *suffix)
+{
+    const char *temp;
+    char *ofile_name;
+
+    /*
+     * Append the suffix to the end of given file name. This
+     * new file contains the statistical data. In case the
+     * file name contains a '/', then extract from the last
+     * slash onwards, otherwise the file is a default_output one.
+     */
+
+    temp = strrchr(file_name, '/');
+    temp = (temp)? temp + 1: "default_output";
 
-        cargs->data[item->task].total_time_consumed += tstamp;
-        cargs->data[item->task].total_operations += 1;
-        printf("Time Taken: %.8lf seconds\n\n", tstamp);
+    ofile_name = malloc(sizeof(*ofile_name) * (strlen(temp) + strlen(suffix) + 1));
+    assert(ofile_name);
+    strcpy(ofile_name, temp);
+    strcat(ofile_name, suffix);
+
+    return ofile_name;
+}
 
-        free(item);
-        free(buf);
+/**
+ * Acquire the suffix of the statistics file of a phase, which
+ * is that of the whole run unless the run has several phases.
+ * 
+ * @param   suffix      The suffix to fill in.
+ * @param   len         Length of the suffix.
+ * @param   phases      The phases of the run.
+ * @param   count       Count of phases.
+ * @param   k           Index of the phase.
+ */
+static void
+_output_phase_suffix(char *suffix, size_t len, struct phase *phases, uint32_t count, uint32_t k)
+{
+    if (count > 1) {
+        snprintf(suffix, len, ".%s.bin", phases[k].name);
+    } else {
+        snprintf(suffix, len, ".bin");
     }
-    global_cstate = CONSUMER_STATE_EXITED_LOOP;
+}
+
+/**
+ * Flush the drive, print the merged statistics of all the
+ * consumers over a phase and write them to the statistics file.
+ * 
+ * @param   ofile_name  Name of the statistics file.
+ * @param   drive_fd    Descriptor of the drive, -1 for none.
+ * @param   data        Merged statistics of all consumers.
+ * @param   profile     Profile of the phase.
+ * @param   stats       Merged arrivals of all producers.
+ */
+static void
+_output_results(const char *ofile_name, int drive_fd, struct data_collection *data,
+                struct work_profile *profile, struct producer_stats *stats)
+{
+    uint64_t ttoken;
+    int64_t tstamp;
+    double total;
+    double write_total;
+    double achieved;
+    int fd;
+    int64_t i;
 
     /*
      * We need to ensure that all the data written is flushed
      * to the drive otherwise the benchmark is not accurate.
      * Calling fsync after each write is dumb however. We call
-     * fsync after the loop and divide the time it takes.
-     */
-    INIT_TIME(&ttoken);
-    fsync(cargs->fd);
-    tstamp = GET_TIME(ttoken);
-    printf("Sync Time: %.8lf seconds\n", tstamp);
-
-    total = rwrite_total + swrite_total;
-    cargs->data[IO_RWRITE].total_time_consumed += (total)? ((rwrite_total/total) * tstamp): 0;
-    cargs->data[IO_SWRITE].total_time_consumed += (total)? ((swrite_total/total) * tstamp): 0;
-
-    /*
-     * Append a ".bin" to the end of given file name. This
-     * new file contains the statistical data. In case the
-     * file name contains a '/', then extract from the last
-     * slash onwards.
-     * 
-     * Reason I am using strdup is so that I can simply free
-     * ofile_name and not care.
+     * fsync after the loop and divide the time it takes amongst
+     * the classes which write, by the bytes each wrote.
      */
+    if (drive_fd >= 0) {
+        INIT_TIME(&ttoken);
+        fsync(drive_fd);
+        tstamp = GET_TIME(ttoken);
+        printf("Sync Time: %.8lf seconds\n", tstamp / 1000000000.0);
 
-    ofile_name = strrchr(cargs->file_name, '/');
-    if (!ofile_name) {
-        ofile_name = strdup("default_output.bin");
-        assert(ofile_name);
-    } else {
-        char *temp = ofile_name + 1;
-        ofile_name = malloc(sizeof(*ofile_name) * (strlen(temp) + 5));
-        assert(ofile_name);
-        strcpy(ofile_name, temp);
-        strcat(ofile_name, ".bin");
+        write_total = 0;
+        for (i = 0; i < profile->count; i++) {
+            write_total += (profile->classes[i].write)? data[i].total_bytes: 0;
+        }
+        for (i = 0; i < profile->count && write_total; i++) {
+            if (profile->classes[i].write) {
+                data[i].total_time_consumed += (data[i].total_bytes / write_total) * tstamp;
+            }
+        }
     }
+
     fd = open(ofile_name, O_WRONLY | O_CREAT | O_TRUNC, 0666);
     assert(fd != -1);
-    free(ofile_name);
 
-    for (i = 0; i < MAX_DATA_POINTS; i++) {
-        if (cargs->data[i].total_operations > 0) {
-            cargs->data[i].avg_time_consumed = cargs->data[i].total_time_consumed / cargs->data[i].total_operations;
+    for (i = 0; i < profile->count; i++) {
+        if (data[i].total_operations > 0) {
+            data[i].avg_time_consumed = (data[i].total_time_consumed / 1000000000.0) / data[i].total_operations;
         } else {
-            cargs->data[i].avg_time_consumed = 0;
+            data[i].avg_time_consumed = 0;
         }
-        printf("%ld. Total Operations: %lu\n", i, cargs->data[i].total_operations);
-        printf("%ld. Average Latency : %.8lf seconds\n", i, cargs->data[i].avg_time_consumed);
-        printf("%ld. Total Time Taken: %.8lf seconds\n\n", i, cargs->data[i].total_time_consumed);
+        printf("%ld. Class           : %s\n", i, profile->classes[i].name);
+        printf("%ld. Total Operations: %lu\n", i, data[i].total_operations);
+        printf("%ld. Average Latency : %.8lf seconds\n", i, data[i].avg_time_consumed);
+        total = data[i].total_time_consumed / 1000000000.0;
+        printf("%ld. Total Time Taken: %.8lf seconds\n\n", i, total);
 
         /*
-         * The format of the output binary file is simple.
+         * The format of the output binary file is simple. For
+         * every class, in the order of the profile:
          *  --> The total number of operations == X (8 bytes).
          *  --> The average time consumed by 1 operation (8 bytes).
          *  --> The total time consumed (8 bytes).
          */ 
 
-        write(fd, &cargs->data[i].total_operations, sizeof(uint64_t));
-        write(fd, &cargs->data[i].avg_time_consumed, sizeof(double));
-        write(fd, &cargs->data[i].total_time_consumed, sizeof(double));
+        write(fd, &data[i].total_operations, sizeof(uint64_t));
+        write(fd, &data[i].avg_time_consumed, sizeof(double));
+        write(fd, &total, sizeof(double));
     }
 
-    close(cargs->fd);
+    /*
+     * The latency distributions of every class follow the
+     * records above, so older readers of the file still work.
+     * For each distribution, in the order service time, response
+     * time and queueing delay, and for each class, LATENCY_POINTS
+     * latencies in seconds (8 bytes each) are written in the
+     * order of percentiles[]. The 0th and 100th percentiles are
+     * the exact minimum and maximum. Latencies exclude the
+     * apportioned sync time.
+     */
+    _output_latency(fd, "Service", data, profile->count, offsetof(struct data_collection, service));
+    _output_latency(fd, "Response", data, profile->count, offsetof(struct data_collection, response));
+    _output_latency(fd, "Queueing", data, profile->count, offsetof(struct data_collection, queueing));
+
+    /*
+     * Finally, the number of arrivals generated (8 bytes) and
+     * the number of those deferred by backpressure (8 bytes).
+     */
+    printf("Deferred Arrivals: %lu of %lu (%.2lf%%)\n", stats->deferred, stats->arrivals,
+           (stats->arrivals)? (100.0 * stats->deferred) / stats->arrivals: 0);
+    write(fd, &stats->arrivals, sizeof(uint64_t));
+    write(fd, &stats->deferred, sizeof(uint64_t));
+
+    /*
+     * And the arrival rate achieved by the producer and the
+     * rate it was asked for, in arrivals per second (8 bytes
+     * each).
+     */
+    achieved = (stats->elapsed > 0)? stats->issued / stats->elapsed: 0;
+    printf("Arrival Rate: %.1lf/s achieved, %.1lf/s target (%.2lf%%)\n", achieved, stats->rate,
+           (stats->rate > 0)? (100.0 * achieved) / stats->rate: 0);
+    write(fd, &achieved, sizeof(double));
+    write(fd, &stats->rate, sizeof(double));
+
+    /*
+     * Then the statistics by size, which tell apart the small
+     * and the large requests the averages above combine. For
+     * reads and then writes, for each of SIZE_BUCKETS buckets of
+     * sizes up to 4KiB, 8KiB, ... 4MiB and beyond 4MiB:
+     *  --> The number of operations (8 bytes).
+     *  --> The bytes transferred (8 bytes).
+     *  --> The average service time in seconds (8 bytes).
+     *  --> The throughput in bytes per second (8 bytes).
+     *  --> LATENCY_POINTS service times in seconds (8 bytes
+     *      each), in the order of percentiles[].
+     */
+    _output_sizes(fd, &data[profile->count], stats->elapsed);
+
     close(fd);
-    return NULL;
 }
 
 /**
- * The producer work function is used to generate workloads for
- * a circular queue depending on a user defined work profile. It
- * generates a workload based on an exponential distribution to emulate
- * a periodic work interval.
+ * Acquire the next inter-arrival gap of the producer, refilling
+ * the block of precomputed gaps out of its arrival process once
+ * it runs out.
  * 
- * @param   args    Producer specific arguments.
- * @return  NULL
+ * @param   pargs   Producer specific arguments.
+ * @param   block   The block of gaps.
+ * 
+ * @return  gap     Seconds until the next arrival.
  */
-void*
-pwork(void *args)
+static inline double
+_next_gap(struct thread_args_producer *pargs, struct gap_block *block)
 {
-    struct thread_args_producer *pargs = args;
-    struct work_item *item;
-    double sleep_time;
-
-    while (1) {
-        sleep_time = get_exponential_variate(pargs->rate) * 1000000;
-        usleep(sleep_time);
-
-        item = _generate_work_item(pargs->profile, pargs->drive_size);
-        cirq_put(pargs->workload, item);
+    if (block->next == GAP_BLOCK) {
+        arrival_gaps(&pargs->arrival, &pargs->gen.rng, block->gaps, GAP_BLOCK);
+        block->next = 0;
     }
 
-    return NULL;
+    return block->gaps[block->next++];
 }
 
 /**
- * The timer work function is another brain dead function whose
- * sole job is to sleep for a set amount of time and then kill the
- * producer and consumer threads.
+ * Hand a batch of items over to the consumers. Arrivals which
+ * are overdue because the producer was held up by a full queue,
+ * or which find the queue full now, are deferred by backpressure.
+ * Nothing is deferred when replaying as fast as possible, as the
+ * queue is meant to be full then.
  * 
- * @param   args    Timer specific arguments.
- * @return  NULL
+ * @param   pargs   Producer specific arguments.
+ * @param   batch   The items to enqueue.
+ * @param   n       Count of items.
+ * @param   late    The batch is overdue due to a full queue.
+ * @param   stalled Set in case the queue was found full.
+ * 
+ * @return  0       Successfully enqueued every item.
+ * @return  -1      The queue was closed, the items left over
+ *                  are returned to the pool.
  */
-void*
-twork(void *args)
+static int
+_pwork_issue(struct thread_args_producer *pargs, struct work_item **batch, uint64_t n,
+             uint8_t late, uint8_t *stalled)
 {
-    struct thread_args_timer *targs = args;
-    long int i;
+    struct producer_stats *stats = &pargs->stats[pargs->phase];
+    uint64_t put;
 
-    for (i = 0; i < targs->timer; i++) {
-        sleep(1);
-        //printf("%ld...", i+1);
-        //fflush(stdout);
+    stats->arrivals += n;
+    put = cirq_try_put_many(pargs->workload, (void**)batch, n);
+    if (late) {
+        stats->deferred += n;
+    } else if (put < n && pargs->speed > 0 && !cirq_closed(pargs->workload)) {
+        stats->deferred += n - put;
+    }
+    if (put < n) {
+        *stalled = 1;
+        put += cirq_put_many(pargs->workload, (void**)batch + put, n - put);
+    }
+    stats->issued += put;
+    if (put < n) {
+        cirq_put_many(pargs->items->free, (void**)batch + put, n - put);
+        return -1;
     }
-    //printf("\n");
-
-    /*
-     ************************************************************
-     * The timer thread cannot simply cancel the consumer
-     * thread as the consumer needs to output its statistics
-     * to a file. Hence, we use a global variable to signify to the
-     * consumer that it needs to stop and output its statistics
-     * to a file. As there is a single writer and single reader,
-     * we do not need to use a mutex. A simple wait in a loop is
-     * enough as we do not care that it waits in a loop one more
-     * time than needed in case of a race condition.
-     * 
-     * It is crucial that the consumer is confirmed to be out
-     * of its loop before the producer is cancelled as otherwise
-     * a system state might be reached such that there is no
-     * producer and the circular queue is empty and so the 
-     * consumer goes to sleep, expecting some thread to wake it
-     * up (hence never exiting its loop). By making sure the consumer 
-     * is stopped first, this state is avoided.
-     ************************************************************
-     */
-
-    global_cstate = CONSUMER_STATE_EXIT_LOOP;
-    while (global_cstate != CONSUMER_STATE_EXITED_LOOP);
 
-    pthread_cancel(*targs->producer);
-    return NULL;
+    return 0;
 }
 
 /**
- * Incredibly crappy function to parse arguments without any
- * sort of error checking.
+ * Replay a compiled trace. Every record is issued on its own
+ * arrival time, with nothing left to draw or compute, so the
+ * same trace drives different drives identically.
  * 
- * The error checking is meant to take place in the pyton
- * front end for the arguments.
+ * Arrival times are divided by the speed of the replay, which
+ * keeps requests that overlapped in the trace overlapping. At
+ * speed 0 records are issued as fast as the queue takes them
+ * and each arrives when it is issued.
+ * 
+ * @param   pargs   Producer specific arguments.
  */
-int 
-parse_args(int argc, char *argv[], struct bench_args *args)
+static void
+_pwork_replay(struct thread_args_producer *pargs)
 {
-    if (argc != ARG_COUNT) {
-        return -1;
-    }
+    struct trace_record *records = pargs->trace->records;
+    struct work_item *batch[MAX_BATCH];
+    uint64_t count = pargs->trace->header->count;
+    uint64_t next = 0, first, n, i, now, elapsed;
+    double speed = pargs->speed;
+    pacer pace;
+    uint8_t stalled = 0, late = 0;
 
-    // Get Probabilities
-    args->prob[0] = atoi(argv[RREAD_PROB]);
-    args->prob[1] = atoi(argv[RWRITE_PROB]);
-    args->prob[2] = atoi(argv[SREAD_PROB]);
-    args->prob[3] = atoi(argv[SWRITE_PROB]);
+    pacer_init(&pace, pargs->start, pargs->spin);
+    while (!cirq_closed(pargs->workload) && next < count) {
+        // Records due within the slack of the pacer go together.
+        first = next;
+        for (n = 0; n < MAX_BATCH && next < count && (speed == 0 ||
+             (records[next].arrival - records[first].arrival) / speed < pace.slack_ns); n++, next++);
 
-    // Get Sizes
-    args->sz[0] = atoll(argv[RREAD_SZ]);
-    args->sz[1] = atoll(argv[RWRITE_SZ]);
-    args->sz[2] = atoll(argv[SREAD_SZ]);
-    args->sz[3] = atoll(argv[SWRITE_SZ]);
+        if (speed > 0) {
+            pacer_schedule(&pace, records[next - 1].arrival / speed);
+            late = 0;
+            if (pacer_wait(&pace) == 0) {
+                stalled = 0;
+            } else if (stalled) {
+                late = 1;
+            }
+        }
 
-    // Get Miscellaneous
-    args->timer = atol(argv[TIMER]);
-    args->lambda = atof(argv[LAMBDA]);
-    args->path = argv[PATH];
+        for (i = 0; i < n; i += cirq_get_many(pargs->items->free, (void**)batch + i, n - i));
+        INIT_TIME(&now);
+        for (i = 0; i < n; i++) {
+            batch[i]->sequence = first + i;
+            batch[i]->task = records[first + i].task;
+            batch[i]->phase = 0;
+            batch[i]->write = records[first + i].write;
+            batch[i]->offset = records[first + i].offset;
+            batch[i]->length = records[first + i].length;
+            batch[i]->arrival = (speed > 0)? pace.start + (uint64_t)(records[first + i].arrival / speed): now;
+        }
 
-    return 0;
+        if (_pwork_issue(pargs, batch, n, late, &stalled)) {
+            break;
+        }
+    }
+    pargs->stats[pargs->phase].elapsed = pacer_elapsed(&pace);
+
+    // Records which were due but never made it out are deferred too.
+    elapsed = pargs->stats[pargs->phase].elapsed * 1000000000.0;
+    for (; speed > 0 && next < count && records[next].arrival / speed <= elapsed; next++) {
+        pargs->stats[pargs->phase].arrivals++;
+        pargs->stats[pargs->phase].deferred++;
+    }
 }
 
 /**
- * Main function is used to setup the threads and execute them.
- * From there on, it basically waits until the timer returns, after
- * which it frees up the used memory and exits.
+ * Acquire the index of the sequential class of a profile which
+ * goes by the name of a class and runs as many streams.
+ * 
+ * @param   profile The profile to look in.
+ * @param   c       The class to look for.
+ * 
+ * @return  index   Index of the class in the profile.
+ * @return  -1      The profile holds no such class.
  */
-int 
-main(int argc, char *argv[])
+static int32_t
+_sequential_match(struct work_profile *profile, struct work_class *c)
 {
-    pthread_t producer, consumer, timer;
-    cirq *qwl;
-    struct bench_args args_data;
-    struct work_profile bench_profile;
-    struct thread_args_consumer cargs;
-    struct thread_args_producer pargs;
-    struct thread_args_timer targs;
-    int ret, fd;
+    struct work_class *p;
+    uint32_t i;
 
-    if (parse_args(argc, argv, &args_data)) {
-        printf("Not Enough Args!\n");
-        return -1;
+    for (i = 0; i < profile->count; i++) {
+        p = &profile->classes[i];
+        if (p->access == ACCESS_SEQUENTIAL && p->streams == c->streams && !strcmp(p->name, c->name)) {
+            return i;
+        }
     }
-    srand(time(0));
 
-    /* Build a work profile out of the arguments provided. For
-     * more information on how the probability distribution is layed
-     * out, refer to "work_profile.h".
-     */
+    return -1;
+}
 
-    bench_profile.flags = 0;
-    if (args_data.prob[0] > 0) {
-        SET_PROFILE_FLAG(bench_profile, RREAD);
-    }
-    if (args_data.prob[1] > 0) {
-        SET_PROFILE_FLAG(bench_profile, RWRITE);
-    }
-    if (args_data.prob[2] > 0) {
-        SET_PROFILE_FLAG(bench_profile, SREAD);
-    }
-    if (args_data.prob[3] > 0) {
-        SET_PROFILE_FLAG(bench_profile, SWRITE);
-    }
-    bench_profile.rread_prob = 0 + args_data.prob[0];
-    bench_profile.rwrite_prob = bench_profile.rread_prob + args_data.prob[1];
-    bench_profile.sread_prob = bench_profile.rwrite_prob + args_data.prob[2];
-    bench_profile.swrite_prob = bench_profile.sread_prob + args_data.prob[3];
-    bench_profile.rread_sz = args_data.sz[0];
-    bench_profile.rwrite_sz = args_data.sz[1];
-    bench_profile.sread_sz = args_data.sz[2];
-    bench_profile.swrite_sz = args_data.sz[3];
-    ASSERT_PROFILE(bench_profile);
+/**
+ * Move the producer on to the next phase of the run, once its
+ * arrivals reach the end of the current one. The generator
+ * starts over on the profile of the phase but carries on with
+ * its random stream, and arrivals start over at the boundary out
+ * of the process of the phase. The arrival drawn past the end of
+ * the previous phase never happens.
+ * 
+ * A sequential class which goes by the name of a sequential class
+ * of an earlier phase, with as many streams, carries on where the
+ * streams of the latest such phase left off rather than going
+ * back to the start of their regions, so that a fill which is
+ * interrupted by another phase resumes.
+ * 
+ * @param   pargs   Producer specific arguments.
+ * @param   pace    Pacer of the producer.
+ * @param   gaps    The block of gaps.
+ */
+static void
+_pwork_phase(struct thread_args_producer *pargs, pacer *pace, struct gap_block *gaps)
+{
+    struct work_class *c;
+    struct phase *ph;
+    uint64_t sequence;
+    uint32_t i, k;
+    int32_t j;
+    rng r;
 
-    // Create the circular queue shared amongst the producer
-    // and the consumer.
-    qwl = cirq_create(MAX_CIRQ_LEN, CIRQ_LOCKING_AND_BLOCKING);
-    assert(qwl != NULL);
+    pargs->stats[pargs->phase].elapsed = pargs->phases[pargs->phase].duration;
+    memcpy(pargs->cursors[pargs->phase], pargs->gen.cursors, sizeof(pargs->gen.cursors));
+    ph = &pargs->phases[++pargs->phase];
 
-    /* 
-     * Create and deploy all the required threads, including filling up
-     * their required parameters. The timer thread controls the execution
-     * of the producer and consumer thread, so main simply waits on the
-     * timer thread.
+    r = pargs->gen.rng;
+    sequence = pargs->gen.sequence;
+    pargs->profile = &ph->profile;
+    _work_generator_init(&pargs->gen, &ph->profile, pargs->gen.base, pargs->drive_size);
+    pargs->gen.rng = r;
+    pargs->gen.sequence = sequence;
+
+    for (i = 0; i < ph->profile.count; i++) {
+        c = &ph->profile.classes[i];
+        for (k = pargs->phase; c->access == ACCESS_SEQUENTIAL && k-- > 0;) {
+            j = _sequential_match(&pargs->phases[k].profile, c);
+            if (j >= 0) {
+                memcpy(pargs->gen.cursors[i], pargs->cursors[k][j], c->streams * sizeof(uint64_t));
+                break;
+            }
+        }
+    }
+
+    arrival_share(&pargs->arrival, &ph->arrival, pargs->shares, &pargs->gen.rng);
+    pacer_schedule(pace, pargs->phase_end - pace->start);
+    pargs->phase_end = (pargs->phase + 1 < pargs->phase_count)?
+                       pargs->phase_end + ph->duration * 1000000000ULL: UINT64_MAX;
+    gaps->next = GAP_BLOCK;
+    pacer_advance(pace, _next_gap(pargs, gaps));
+}
+
+/**
+ * The producer work function is used to generate workloads for
+ * a circular queue depending on a user defined work profile. It
+ * generates a workload based on an exponential distribution to emulate
+ * a periodic work interval. In case a compiled trace is given, the
+ * trace is replayed instead.
+ * 
+ * Arrivals are paced on absolute deadlines, so time lost while
+ * the queue is full is caught up on afterwards instead of being
+ * silently dropped. Every item carries its intended arrival and
+ * the phase it arrived in. A batch never spans two phases.
+ * 
+ * @param   args    Producer specific arguments.
+ * @return  NULL
+ */
+void*
+pwork(void *args)
+{
+    struct thread_args_producer *pargs = args;
+    struct work_item *batch[MAX_BATCH];
+    uint64_t arrivals[MAX_BATCH];
+    struct gap_block gaps;
+    pacer pace;
+    double gap, span;
+    uint64_t n, i;
+    uint8_t stalled = 0, late;
+
+    if (pargs->trace) {
+        _pwork_replay(pargs);
+        return NULL;
+    }
+
+    gaps.next = GAP_BLOCK;
+    pacer_init(&pace, pargs->start, pargs->spin);
+    pargs->phase_end = (pargs->phase_count > 1)?
+                       pace.start + pargs->phases[0].duration * 1000000000ULL: UINT64_MAX;
+    pacer_advance(&pace, _next_gap(pargs, &gaps));
+    while (!cirq_closed(pargs->workload)) {
+        while (pace.deadline >= pargs->phase_end) {
+            _pwork_phase(pargs, &pace, &gaps);
+        }
+
+        /*
+         * Arrivals following the current one by less than the
+         * slack of the pacer are due at once. They are issued as
+         * a single batch once the last of them is due.
+         */
+        n = 0;
+        span = 0;
+        arrivals[n++] = pace.deadline;
+        gap = _next_gap(pargs, &gaps);
+        while (n < MAX_BATCH && (span + gap) * 1000000000 < pace.slack_ns &&
+               pace.deadline + (uint64_t)(gap * 1000000000.0 + 0.5) < pargs->phase_end) {
+            span += gap;
+            pacer_advance(&pace, gap);
+            arrivals[n++] = pace.deadline;
+            gap = _next_gap(pargs, &gaps);
+        }
+
+        late = 0;
+        if (pacer_wait(&pace) == 0) {
+            stalled = 0;
+        } else if (stalled) {
+            late = 1;
+        }
+        pacer_advance(&pace, gap);
+
+        for (i = 0; i < n; i += cirq_get_many(pargs->items->free, (void**)batch + i, n - i));
+        _generate_work_items(batch, n, pargs->profile, pargs->drive_size, &pargs->gen);
+        for (i = 0; i < n; i++) {
+            batch[i]->arrival = arrivals[i];
+            batch[i]->phase = pargs->phase;
+        }
+
+        if (_pwork_issue(pargs, batch, n, late, &stalled)) {
+            break;
+        }
+    }
+    pargs->stats[pargs->phase].elapsed = pacer_elapsed(&pace) - script_duration(pargs->phases, pargs->phase);
+
+    // Arrivals which were due but never made it out are deferred too.
+    while (GET_TIME(pace.deadline) > 0) {
+        pargs->stats[pargs->phase].arrivals++;
+        pargs->stats[pargs->phase].deferred++;
+        pacer_advance(&pace, _next_gap(pargs, &gaps));
+    }
+
+    return NULL;
+}
+
+/**
+ * Remove a trace which could not be written in full, so that it
+ * is never replayed truncated. Only a regular file is removed, a
+ * trace written to a device or a pipe is left alone.
+ * 
+ * @param   path    Path of the trace.
+ */
+static void
+_discard_trace(const char *path)
+{
+    struct stat st;
+
+    if (!stat(path, &st) && S_ISREG(st.st_mode)) {
+        unlink(path);
+    }
+}
+
+/**
+ * Convert a text trace into a compiled trace, one line at a
+ * time, so that traces of any size can be converted. Arrivals
+ * are taken relative to the first request. Requests which
+ * start where one of the last IMPORT_STREAMS requests in the
+ * same direction ended count as sequential, the others as
+ * random, so interleaved streams are still told apart.
+ * 
+ * The drive size the trace needs is the furthest byte it
+ * touches, and its alignment the largest power of two dividing
+ * every offset and length. A trace which could not be written
+ * in full is removed rather than left behind truncated.
+ * 
+ * @param   text    Path of the text trace.
+ * @param   path    Path of the compiled trace.
+ * 
+ * @return  0       Successfully converted.
+ * @return  -1      Either trace could not be opened or written.
+ */
+static int
+_import_trace(const char *text, const char *path)
+{
+    struct trace_event event;
+    struct trace_record record;
+    uint64_t end[2][IMPORT_STREAMS];
+    uint64_t first = UINT64_MAX, last = 0, next[2] = {0, 0};
+    uint64_t bits = 0, drive_size = 0, malformed = 0, reordered = 0;
+    char *line = NULL;
+    size_t cap = 0;
+    FILE *in;
+    trace *t;
+    int ret, i, failed = 0;
+
+    memset(end, 0xff, sizeof end);
+    in = fopen(text, "r");
+    if (!in) {
+        return -1;
+    }
+    t = trace_create(path, 0, 0, 1);
+    if (!t) {
+        fclose(in);
+        return -1;
+    }
+
+    while (getline(&line, &cap, in) != -1) {
+        ret = trace_parse(line, &event);
+        if (ret < 0) {
+            malformed++;
+        }
+        if (ret <= 0) {
+            continue;
+        }
+
+        // Requests must not go back in time.
+        if (first == UINT64_MAX) {
+            first = event.time;
+        }
+        record.arrival = (event.time > first)? event.time - first: 0;
+        if (record.arrival < last) {
+            record.arrival = last;
+            reordered++;
+        }
+        last = record.arrival;
+
+        for (i = 0; i < IMPORT_STREAMS && end[event.write][i] != event.offset; i++);
+        if (i == IMPORT_STREAMS) {
+            i = next[event.write]++ % IMPORT_STREAMS;
+            record.task = (event.write)? IO_RWRITE: IO_RREAD;
+        } else {
+            record.task = (event.write)? IO_SWRITE: IO_SREAD;
+        }
+        end[event.write][i] = event.offset + event.length;
+        record.write = event.write;
+        record.reserved = 0;
+        record.offset = event.offset;
+        record.length = event.length;
+
+        bits |= event.offset | event.length;
+        drive_size = MAX(drive_size, event.offset + event.length);
+        if (trace_append(t, &record)) {
+            failed = 1;
+            break;
+        }
+    }
+    free(line);
+    fclose(in);
+
+    t->header->drive_size = drive_size;
+    t->header->align = (bits)? (bits & -bits): 1;
+    if (failed) {
+        printf("Could not write %s after %lu requests\n", path, t->header->count);
+        trace_finish(t, last + 1);
+        _discard_trace(path);
+        return -1;
+    }
+
+    printf("Imported %lu requests from %s into %s (%lu malformed lines, %lu out of order)\n",
+           t->header->count, text, path, malformed, reordered);
+    if (trace_finish(t, last + 1)) {
+        _discard_trace(path);
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * Compile the work profile into a trace covering the duration
+ * of the run. Arrivals are drawn as the live producer draws them,
+ * starting from the same seed, and items one at a time out of the
+ * same distributions as its batches.
+ * 
+ * @param   pargs   Producer specific arguments.
+ * @param   path    Path of the trace file.
+ * @param   align   Alignment of the offsets.
+ * @param   seed    Seed the generator was seeded with.
+ * @param   timer   Duration of the run in seconds.
+ * 
+ * @return  0       Successfully compiled.
+ * @return  -1      The trace could not be written.
+ */
+static int
+_compile_trace(struct thread_args_producer *pargs, const char *path, uint64_t align,
+               uint64_t seed, long int timer)
+{
+    struct trace_record record;
+    struct work_item item;
+    struct gap_block gaps;
+    uint64_t arrival, duration;
+    trace *t;
+
+    t = trace_create(path, seed, pargs->drive_size, align);
+    if (!t) {
+        return -1;
+    }
+
+    // Gaps are rounded to nanoseconds one by one, as the pacer does.
+    gaps.next = GAP_BLOCK;
+    duration = (uint64_t)timer * 1000000000ULL;
+    for (arrival = _next_gap(pargs, &gaps) * 1000000000.0 + 0.5; arrival < duration;
+         arrival += (uint64_t)(_next_gap(pargs, &gaps) * 1000000000.0 + 0.5)) {
+        _generate_work_item(&item, pargs->profile, pargs->drive_size, &pargs->gen);
+        record.arrival = arrival;
+        record.offset = item.offset;
+        record.length = item.length;
+        record.task = item.task;
+        record.write = item.write;
+        record.reserved = 0;
+        if (trace_append(t, &record)) {
+            trace_finish(t, duration);
+            _discard_trace(path);
+            return -1;
+        }
+    }
+
+    printf("Compiled %lu arrivals into %s\n", t->header->count, path);
+    return trace_finish(t, duration);
+}
+
+/**
+ * The timer work function is another brain dead function whose
+ * sole job is to sleep until a set amount of time has passed on
+ * the common clock and then stop the producer and consumer threads
+ * of every pipeline.
+ * 
+ * @param   args    Timer specific arguments.
+ * @return  NULL
+ */
+void*
+twork(void *args)
+{
+    struct thread_args_timer *targs = args;
+    pacer pace;
+    uint32_t i;
+
+    pacer_init(&pace, targs->start, 1);
+    pacer_schedule(&pace, (uint64_t)targs->timer * 1000000000ULL);
+    pacer_wait(&pace);
+
+    /*
+     ************************************************************
+     * The timer thread cannot simply cancel the consumer
+     * threads as their statistics need to be output to a file.
+     * Hence, it closes the queue of every pipeline to signify
+     * to its consumers and its producer that they need to stop.
+     * Pipelines share no flag of any sort, so this and the
+     * common start are the only points they synchronize at.
      * 
-     * Also acquire the size of the disk drive.
+     * A consumer asleep on an empty queue, expecting the
+     * producer to wake it up, or a producer asleep on a full
+     * queue, is woken up by the close as well. Items still in
+     * the queues are never executed.
+     ************************************************************
      */
 
-    fd = open(args_data.path, O_RDWR);
-    assert(fd != -1);
+    for (i = 0; i < targs->count; i++) {
+        cirq_close(targs->workloads[i]);
+    }
 
-    // Timer.
-    targs.producer = &producer;
-    targs.consumer = &consumer;
-    targs.timer = args_data.timer;
-    ret = pthread_create(&timer, NULL, twork, &targs);
-    assert(ret == 0);
+    return NULL;
+}
 
-    // Consumer.
-    cargs.file_name = args_data.path;
-    cargs.fd = fd;
-    cargs.workload = qwl;
-    ret = pthread_create(&consumer, NULL, cwork, &cargs);
+/**
+ * Account for every work item once all threads have stopped.
+ * Items which were still queued when the run ended are never
+ * executed and are returned to the pool here. Any item missing
+ * from the pool after that has been lost by a thread.
+ * 
+ * @param   items   The work item pool.
+ * @param   q       The (closed) workload queue.
+ */
+static void
+_account_work_items(struct work_pool *items, cirq *q)
+{
+    struct work_item *item;
+    uint64_t queued, free_count;
+
+    queued = 0;
+    while ((item = cirq_try_get(q)) != NULL) {
+        cirq_put(items->free, item);
+        queued++;
+    }
+
+    // Count the free ring by cycling it once.
+    free_count = 0;
+    while (free_count < items->count && (item = cirq_try_get(items->free)) != NULL) {
+        cirq_put(items->free, item);
+        free_count++;
+    }
+
+    printf("Work Items: %lu total, %lu unexecuted at exit, %lu lost\n",
+    items->count, queued, items->count - free_count);
+    assert(free_count == items->count);
+}
+
+/**
+ * Acquire the alignment direct I/O requires on a drive. For
+ * a block device this is its logical block size, for a regular
+ * file it is the block size of the file system.
+ * 
+ * @param   fd      Descriptor of the drive.
+ * 
+ * @return  align   Required alignment in bytes.
+ */
+static uint64_t
+_drive_alignment(int fd)
+{
+    struct stat st;
+    int sector;
+
+    if (fstat(fd, &st)) {
+        return 4096;
+    }
+
+    if (S_ISBLK(st.st_mode) && !ioctl(fd, BLKSSZGET, &sector)) {
+        return sector;
+    }
+
+    return st.st_blksize;
+}
+
+/**
+ * Open a drive and build the phases of its pipeline. As direct
+ * I/O dictates the alignment of every request, the profile of
+ * every phase takes on the alignment of the drive, which every
+ * size drawn and every stride is rounded up to, and its usable
+ * size is rounded down to it.
+ * 
+ * @param   tg          The pipeline of the drive.
+ * @param   path        Path of the drive.
+ * @param   args        Arguments of the run.
+ * @param   phases      The phases of the run.
+ * @param   phase_count Count of phases.
+ */
+static void
+_target_open(struct target *tg, char *path, struct bench_args *args, struct phase *phases,
+             uint32_t phase_count)
+{
+    struct work_profile *profile;
+    struct work_class *c;
+    uint32_t i, k;
+
+    tg->path = path;
+    tg->fd = open(path, O_RDWR | ((args->direct)? O_DIRECT: 0));
+    assert(tg->fd != -1);
+
+    tg->drive_size = lseek(tg->fd, 0L, SEEK_END);
+    tg->align = (args->direct)? _drive_alignment(tg->fd): 1;
+    tg->drive_size -= tg->drive_size % tg->align;
+
+    tg->phase_count = phase_count;
+    tg->phases = malloc(sizeof(*tg->phases) * phase_count);
+    tg->bases = malloc(sizeof(*tg->bases) * (phase_count + 1));
+    assert(tg->phases && tg->bases);
+
+    tg->bases[0] = 0;
+    for (k = 0; k < phase_count; k++) {
+        tg->phases[k] = phases[k];
+        profile = &tg->phases[k].profile;
+        profile->align = tg->align;
+        for (i = 0; i < profile->count; i++) {
+            c = &profile->classes[i];
+            if (c->stride % tg->align) {
+                c->stride += tg->align - (c->stride % tg->align);
+                printf("Stride of %s rounded up to %lu bytes for direct I/O on %s\n", c->name, c->stride, path);
+            }
+        }
+        tg->bases[k + 1] = tg->bases[k] + profile->count + SIZE_STATS;
+    }
+}
+
+/**
+ * Add the statistics of one set of classes to another.
+ * 
+ * @param   dst     Statistics to add to.
+ * @param   src     Statistics to add.
+ * @param   count   Count of classes.
+ */
+static void
+_merge_data(struct data_collection *dst, struct data_collection *src, uint32_t count)
+{
+    uint32_t i;
+
+    for (i = 0; i < count; i++) {
+        dst[i].total_operations += src[i].total_operations;
+        dst[i].total_bytes += src[i].total_bytes;
+        dst[i].total_time_consumed += src[i].total_time_consumed;
+        histogram_merge(&dst[i].service, &src[i].service);
+        histogram_merge(&dst[i].queueing, &src[i].queueing);
+        histogram_merge(&dst[i].response, &src[i].response);
+    }
+}
+
+/**
+ * Add the arrivals of one producer over a phase to those of
+ * another. The rates of the producers add up as well, over the
+ * longest time either of them took.
+ * 
+ * @param   dst     Arrivals to add to.
+ * @param   src     Arrivals to add.
+ */
+static void
+_merge_producer(struct producer_stats *dst, struct producer_stats *src)
+{
+    dst->arrivals += src->arrivals;
+    dst->deferred += src->deferred;
+    dst->issued += src->issued;
+    dst->rate += src->rate;
+    dst->elapsed = MAX(dst->elapsed, src->elapsed);
+}
+
+/**
+ * Allocate a set of statistics, one per class.
+ * 
+ * @param   count   Count of classes.
+ * 
+ * @return  The statistics, reset.
+ */
+static struct data_collection*
+_create_data(uint32_t count)
+{
+    struct data_collection *data;
+    uint32_t i;
+
+    data = calloc(count, sizeof(*data));
+    assert(data != NULL);
+    for (i = 0; i < count; i++) {
+        histogram_init(&data[i].service);
+        histogram_init(&data[i].queueing);
+        histogram_init(&data[i].response);
+    }
+
+    return data;
+}
+
+/**
+ * Acquire the CPUs the workers of a drive may run on. Those are
+ * the CPUs of its NUMA node the process is allowed to run on, or
+ * all of the allowed CPUs if there are none.
+ * 
+ * @param   tg      The drive.
+ * @param   allowed CPUs the process is allowed to run on.
+ * @param   set     The set to fill in.
+ */
+static void
+_target_cpus(struct target *tg, cpu_set_t *allowed, cpu_set_t *set)
+{
+    cpu_set_t node;
+
+    if (tg->node >= 0 && !affinity_node_cpus(tg->node, &node)) {
+        CPU_AND(set, &node, allowed);
+        if (CPU_COUNT(set)) {
+            return;
+        }
+    }
+
+    tg->node = NUMA_NONE;
+    CPU_OR(set, allowed, allowed);
+}
+
+/**
+ * Acquire the index of the n-th CPU in a set.
+ * 
+ * @param   set     The set of CPUs.
+ * @param   n       Index of the CPU within the set.
+ * 
+ * @return  cpu     The n-th CPU, wrapping around the set.
+ */
+static int32_t
+_nth_cpu(cpu_set_t *set, uint32_t n)
+{
+    int32_t cpu;
+
+    n %= CPU_COUNT(set);
+    for (cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (CPU_ISSET(cpu, set) && n-- == 0) {
+            break;
+        }
+    }
+
+    return cpu;
+}
+
+/**
+ * Create a thread, pinned to a set of CPUs unless it is NULL.
+ * 
+ * @param   thread  The thread to create.
+ * @param   set     The CPUs to pin the thread to.
+ * @param   fn      Work function of the thread.
+ * @param   arg     Argument of the work function.
+ */
+static void
+_spawn(pthread_t *thread, cpu_set_t *set, void *(*fn)(void*), void *arg)
+{
+    pthread_attr_t attr;
+    int ret;
+
+    ret = pthread_attr_init(&attr);
     assert(ret == 0);
+    if (set) {
+        ret = pthread_attr_setaffinity_np(&attr, sizeof(*set), set);
+        assert(ret == 0);
+    }
 
-    // Producer.
-    pargs.rate = 1 / args_data.lambda;
-    pargs.workload = qwl;
-    pargs.profile = &bench_profile;
-    pargs.drive_size = lseek(fd, 0L, SEEK_END);
-    ret = pthread_create(&producer, NULL, pwork, &pargs);
+    ret = pthread_create(thread, &attr, fn, arg);
     assert(ret == 0);
+    pthread_attr_destroy(&attr);
+}
+
+/**
+ * Set up the producers of every shard of a drive. Each producer
+ * draws from a stream of its own, so shares and drives see
+ * independent workloads while a single drive still sees exactly
+ * the workload of the seed. Every producer starts out on the
+ * first phase, at an even share of its arrivals.
+ * 
+ * @param   tg      The drive.
+ * @param   seed    Seed of the run.
+ * @param   first   Index of the first producer of the drive
+ *                  amongst those of every drive.
+ */
+static void
+_target_producers(struct target *tg, uint64_t seed, uint32_t first)
+{
+    struct shard *sh;
+    uint64_t share;
+    uint32_t shards, s, k, j;
+
+    shards = tg->shard_count;
+    share = tg->drive_size / shards;
+    share -= share % tg->align;
+    for (s = 0; s < shards; s++) {
+        sh = &tg->shards[s];
+        sh->pargs.stats = calloc(tg->phase_count, sizeof(*sh->pargs.stats));
+        assert(sh->pargs.stats != NULL);
+        sh->pargs.cursors = NULL;
+        if (tg->phase_count > 1) {
+            sh->pargs.cursors = malloc((tg->phase_count - 1) * sizeof(*sh->pargs.cursors));
+            assert(sh->pargs.cursors != NULL);
+        }
+        for (k = 0; k < tg->phase_count; k++) {
+            sh->pargs.stats[k].rate = arrival_mean_rate(&tg->phases[k].arrival, tg->phases[k].duration) / shards;
+        }
+        sh->pargs.shares = shards;
+        sh->pargs.phases = tg->phases;
+        sh->pargs.phase_count = tg->phase_count;
+        sh->pargs.phase = 0;
+        sh->pargs.profile = &tg->phases[0].profile;
+        sh->pargs.trace = NULL;
+        sh->pargs.speed = 1;
+        sh->pargs.drive_size = (s == shards - 1)? tg->drive_size - s * share: share;
+        _work_generator_init(&sh->pargs.gen, sh->pargs.profile, s * share, sh->pargs.drive_size);
+        rng_seed(&sh->pargs.gen.rng, seed);
+        for (j = 0; j < first + s; j++) {
+            rng_jump(&sh->pargs.gen.rng);
+        }
+        arrival_share(&sh->pargs.arrival, &tg->phases[0].arrival, shards, &sh->pargs.gen.rng);
+    }
+}
+
+/**
+ * Create the queue, the pools and the consumers of every shard
+ * of a drive. Those of a drive placed on a NUMA node are faulted
+ * in on that node, which is also where its workers run. Whatever
+ * a worker allocates itself is faulted in where it runs anyway.
+ * 
+ * @param   tg          The drive.
+ * @param   args        Arguments of the run.
+ * @param   replay      Trace to replay, if any.
+ * @param   workloads   The queues of the drive to fill in.
+ */
+static void
+_target_pipelines(struct target *tg, struct bench_args *args, trace *replay, cirq **workloads)
+{
+    struct shard *sh;
+    uint64_t qlen, max_io_size;
+    uint32_t s, c, k, depth;
+    uint8_t qtype;
+
+    depth = (args->engine == IO_ENGINE_URING)? args->iodepth: 1;
+    if (tg->node >= 0 && affinity_set_node(tg->node)) {
+        printf("Could not place the memory of %s on node %d\n", tg->path, tg->node);
+    }
+
+    for (s = 0; s < tg->shard_count; s++) {
+        sh = &tg->shards[s];
+
+        /*
+         * Create the circular queue shared amongst the producer
+         * and the consumers of the shard. The queue needs to at
+         * least be able to hold as many items as all the
+         * consumers together can have outstanding, otherwise the
+         * queue depth is capped by it.
+         */
+        qlen = 2 * (uint64_t)sh->consumer_count * args->iodepth;
+        qlen = (qlen > MAX_CIRQ_LEN)? qlen: MAX_CIRQ_LEN;
+        qtype = CIRQ_LOCKING_AND_BLOCKING;
+        if (args->lockfree) {
+            qtype = (sh->consumer_count == 1)? CIRQ_LOCKFREE_SPSC: CIRQ_LOCKFREE_MPMC;
+        }
+        sh->workload = cirq_create(qlen, qtype);
+        assert(sh->workload != NULL);
+        workloads[s] = sh->workload;
+
+        /*
+         * The work item pool covers the queue, every consumer
+         * slot or batch and the batch being generated by the
+         * producer. Items flow back from the consumers to the
+         * producer, but the producer also returns the batch it
+         * could not enqueue once the queue is closed, possibly
+         * while a consumer is returning its own. The free ring
+         * therefore always takes several producers, even when
+         * the queue is single producer single consumer.
+         */
+        sh->items = _work_pool_create(sh->workload->len + (uint64_t)sh->consumer_count * MAX(depth, MAX_BATCH) + MAX_BATCH,
+                                      (qtype == CIRQ_LOCKFREE_SPSC)? CIRQ_LOCKFREE_MPMC: qtype);
+        assert(sh->items != NULL);
+
+        // The buffers for every consumer are allocated up front so
+        // that no allocation happens during the run.
+        max_io_size = (replay)? replay->header->max_length: 0;
+        for (k = 0; k < tg->phase_count; k++) {
+            max_io_size = MAX(max_io_size, work_profile_max_size(&tg->phases[k].profile));
+        }
+        sh->buffers = bufpool_create((uint64_t)sh->consumer_count * depth, max_io_size,
+                                     tg->align, args->hugepages);
+        assert(sh->buffers != NULL);
+
+        sh->consumers = malloc(sizeof(*sh->consumers) * sh->consumer_count);
+        sh->cargs = malloc(sizeof(*sh->cargs) * sh->consumer_count);
+        assert(sh->consumers && sh->cargs);
+
+        for (c = 0; c < sh->consumer_count; c++) {
+            sh->cargs[c].id = c;
+            sh->cargs[c].fd = tg->fd;
+            sh->cargs[c].workload = sh->workload;
+            sh->cargs[c].items = sh->items;
+            sh->cargs[c].data = NULL;
+            sh->cargs[c].bases = tg->bases;
+            sh->cargs[c].phases = tg->phase_count;
+            sh->cargs[c].timeline = NULL;
+            sh->cargs[c].recorder = NULL;
+            sh->cargs[c].engine = args->engine;
+            sh->cargs[c].iodepth = depth;
+            sh->cargs[c].batch = (sh->consumer_count == 1)? MAX_BATCH: 1;
+            sh->cargs[c].fixed = args->fixed;
+            sh->cargs[c].verbose = args->verbose;
+            sh->cargs[c].max_io_size = max_io_size;
+            sh->cargs[c].buffers = sh->buffers;
+            sh->cargs[c].buf_base = (uint64_t)c * depth;
+        }
+
+        sh->pargs.workload = sh->workload;
+        sh->pargs.items = sh->items;
+    }
+
+    if (tg->node >= 0) {
+        affinity_set_node(NUMA_NONE);
+    }
+}
+
+/**
+ * Run the pipelines of every drive once, from the common start
+ * until the timer stops them, and merge the statistics of every
+ * shard of every drive.
+ * 
+ * @param   targets     The drives.
+ * @param   count       Count of drives.
+ * @param   tcpus       CPUs the workers of every drive may run on.
+ * @param   args        Arguments of the run.
+ * @param   workloads   The queues of every shard of every drive.
+ * 
+ * @return  start       Time the run started at.
+ */
+static uint64_t
+_run(struct target *targets, uint32_t count, cpu_set_t *tcpus, struct bench_args *args, cirq **workloads)
+{
+    struct thread_args_timer targs;
+    struct target *tg;
+    struct shard *sh;
+    pthread_t timer;
+    cpu_set_t pin, *set, *pset, *cset;
+    uint64_t start;
+    uint32_t t, s, c, g, k;
+    uint8_t spin;
+
+    /* 
+     * Deploy all the required threads. The timer thread controls the
+     * execution of the producer and consumer threads, so the run
+     * simply waits on all of them.
+     * 
+     * The common clock starts a little ahead so that every thread
+     * is up by then and no pipeline gets a head start.
+     */
+
+    INIT_TIME(&start);
+    start += START_LEAD_NS;
+
+    /*
+     * Threads of a role with CPUs of its own run on those. The
+     * others run on the CPU of their share in the per core mode,
+     * or on the CPUs of the NUMA node of their drive.
+     */
+    for (t = 0, g = 0; t < count; t++) {
+        tg = &targets[t];
+        tg->timeline = timeline_create(start, args->timer + TIMELINE_SLACK);
+        assert(tg->timeline != NULL);
+        for (s = 0; s < tg->shard_count; s++, g++) {
+            sh = &tg->shards[s];
+            set = (tg->node >= 0)? &tcpus[t]: NULL;
+            if (sh->cpu >= 0) {
+                CPU_ZERO(&pin);
+                CPU_SET(sh->cpu, &pin);
+                set = &pin;
+            }
+            pset = (args->role_pinned[ROLE_PRODUCER])? &args->role_cpus[ROLE_PRODUCER]: set;
+            cset = (args->role_pinned[ROLE_CONSUMER])? &args->role_cpus[ROLE_CONSUMER]: set;
+
+            /*
+             * A producer confined to the single CPU its consumers
+             * are confined to, as in the per core mode, takes turns
+             * with them on it. Neither side may spin then, as that
+             * only holds up the side spun on.
+             */
+            spin = !(pset && cset && CPU_COUNT(pset) == 1 && CPU_EQUAL(pset, cset));
+            cirq_set_spin(sh->workload, spin);
+            cirq_set_spin(sh->items->free, spin);
+
+            for (c = 0; c < sh->consumer_count; c++) {
+                sh->cargs[c].timeline = tg->timeline;
+                _spawn(&sh->consumers[c], cset, cwork, &sh->cargs[c]);
+            }
+
+            sh->pargs.start = start;
+            sh->pargs.spin = spin;
+            _spawn(&sh->producer, pset, pwork, &sh->pargs);
+        }
+    }
+
+    // Timer.
+    targs.workloads = workloads;
+    targs.count = g;
+    targs.timer = args->timer;
+    targs.start = start;
+    _spawn(&timer, (args->role_pinned[ROLE_TIMER])? &args->role_cpus[ROLE_TIMER]: NULL,
+           twork, &targs);
 
     pthread_join(timer, NULL);
-    pthread_join(consumer, NULL);
-    pthread_join(consumer, NULL);
-    cirq_free(qwl);
+
+    // Merge the statistics of every shard of every drive.
+    for (t = 0; t < count; t++) {
+        tg = &targets[t];
+        tg->data = _create_data(tg->bases[tg->phase_count]);
+        tg->stats = calloc(tg->phase_count, sizeof(*tg->stats));
+        assert(tg->stats != NULL);
+        for (s = 0; s < tg->shard_count; s++) {
+            sh = &tg->shards[s];
+            pthread_join(sh->producer, NULL);
+            for (k = 0; k < tg->phase_count; k++) {
+                _merge_producer(&tg->stats[k], &sh->pargs.stats[k]);
+            }
+
+            for (c = 0; c < sh->consumer_count; c++) {
+                pthread_join(sh->consumers[c], NULL);
+                _merge_data(tg->data, sh->cargs[c].data, tg->bases[tg->phase_count]);
+                free(sh->cargs[c].data);
+            }
+        }
+    }
+
+    return start;
+}
+
+/**
+ * Release everything a run of the pipelines of a drive holds,
+ * which leaves the drive open for another run.
+ * 
+ * @param   tg      The drive.
+ */
+static void
+_target_release(struct target *tg)
+{
+    struct shard *sh;
+    uint32_t s;
+
+    for (s = 0; s < tg->shard_count; s++) {
+        sh = &tg->shards[s];
+        cirq_free(sh->workload);
+        _work_pool_free(sh->items);
+        bufpool_free(sh->buffers);
+        free(sh->cargs);
+        free(sh->consumers);
+        free(sh->pargs.stats);
+        free(sh->pargs.cursors);
+    }
+    free(tg->stats);
+    free(tg->data);
+    timeline_free(tg->timeline);
+}
+
+/**
+ * Measure a single rate of a saturation search, print it and
+ * append it to the curve. The rate offered and achieved are
+ * those of every drive together, the latencies those of the
+ * response time across every class and drive. The rate is met
+ * if the latency target holds and the drives completed nearly
+ * every arrival. Arrivals merely queued up when the run stopped
+ * do not count, so a backlog the drives never worked through
+ * misses the rate even with every arrival issued.
+ * 
+ * @param   curve       The curve of the search.
+ * @param   sr          The search.
+ * @param   targets     The drives, after the run at the rate.
+ * @param   count       Count of drives.
+ * 
+ * @return  1           The rate met the target.
+ * @return  0           It did not.
+ */
+static uint8_t
+_search_measure(FILE *curve, search *sr, struct target *targets, uint32_t count)
+{
+    static const double points[] = {50, 99, 99.9, 100};
+    histogram *h;
+    double lat[4], slo, offered = 0, elapsed = 0, iops, rate;
+    uint64_t ops = 0, bytes = 0, arrivals = 0, deferred = 0;
+    uint32_t t, i, p;
+    uint8_t met;
+
+    h = malloc(sizeof(*h));
+    assert(h != NULL);
+    histogram_init(h);
+    for (t = 0; t < count; t++) {
+        for (i = 0; i < targets[t].phases[0].profile.count; i++) {
+            histogram_merge(h, &targets[t].data[i].response);
+            ops += targets[t].data[i].total_operations;
+            bytes += targets[t].data[i].total_bytes;
+        }
+        offered += targets[t].stats[0].rate;
+        arrivals += targets[t].stats[0].arrivals;
+        deferred += targets[t].stats[0].deferred;
+        elapsed = MAX(elapsed, targets[t].stats[0].elapsed);
+    }
+
+    for (p = 0; p < 4; p++) {
+        lat[p] = histogram_percentile(h, points[p]) / 1000.0;
+    }
+    slo = histogram_percentile(h, sr->percentile) / 1000.0;
+    iops = (elapsed > 0)? ops / elapsed: 0;
+    rate = (elapsed > 0)? bytes / elapsed / 1048576.0: 0;
+    met = ops && slo * 1000.0 <= sr->limit && ops >= SEARCH_KEEP_UP * arrivals;
+    free(h);
+
+    printf("Step %u: %.1lf/s offered, %.1lf/s achieved, %.2lf MiB/s, p50=%.1lf p99=%.1lf p99.9=%.1lf "
+           "p100=%.1lf us, %.2lf%% deferred, p%g=%.1lf us %s\n", sr->tried, offered, iops, rate,
+           lat[0], lat[1], lat[2], lat[3], (arrivals)? (100.0 * deferred) / arrivals: 0,
+           sr->percentile, slo, (met)? "met": "missed");
+    fprintf(curve, "%.1lf,%.1lf,%.1lf,%.3lf,%.1lf,%.1lf,%.1lf,%.1lf,%.1lf,%.4lf,%u\n", sr->rate, offered, iops, rate,
+            lat[0], lat[1], lat[2], lat[3], slo, (arrivals)? (100.0 * deferred) / arrivals: 0, met);
+    fflush(curve);
+
+    return met;
+}
+
+/**
+ * Search for the highest Poisson arrival rate the drives sustain
+ * within a latency target. Every rate tried gets a run of its own
+ * of TIMER seconds on fresh pipelines, which leaves the drives
+ * open and is flushed to them before the next run. The rate goes
+ * to every drive, as LAMBDA does.
+ * 
+ * A rate meets the target if the percentile of the response
+ * time is within its limit and the drives completed all but a
+ * sliver of the arrivals, so that a backlog left behind in the
+ * queues cannot pass for a low latency. Every rate is appended
+ * to the curve as it is measured, so a search cut short still
+ * leaves the rates it got through. For the searches themselves,
+ * refer to "search/search.h".
+ * 
+ * @param   sr          The search.
+ * @param   name        Name of the curve file.
+ * @param   targets     The drives.
+ * @param   count       Count of drives.
+ * @param   tcpus       CPUs the workers of every drive may run on.
+ * @param   args        Arguments of the run.
+ * @param   workloads   The queues of every shard of every drive.
+ * 
+ * @return  0           The search ran.
+ * @return  -1          The curve could not be written.
+ */
+static int
+_search(search *sr, const char *name, struct target *targets, uint32_t count, cpu_set_t *tcpus,
+        struct bench_args *args, cirq **workloads)
+{
+    FILE *curve;
+    double rate;
+    uint32_t t, g;
+
+    curve = fopen(name, "w");
+    if (!curve) {
+        return -1;
+    }
+    fprintf(curve, "rate,offered,iops,mib_per_s,p50_us,p99_us,p99.9_us,max_us,slo_us,deferred_pct,met\n");
+
+    while (!search_next(sr, &rate)) {
+        for (t = 0, g = 0; t < count; g += targets[t++].shard_count) {
+            arrival_poisson(&targets[t].phases[0].arrival, rate);
+            _target_producers(&targets[t], args->seed, g);
+            _target_pipelines(&targets[t], args, NULL, &workloads[g]);
+        }
+        _run(targets, count, tcpus, args, workloads);
+
+        search_report(sr, _search_measure(curve, sr, targets, count));
+        for (t = 0; t < count; t++) {
+            fsync(targets[t].fd);
+            _target_release(&targets[t]);
+        }
+    }
+    fclose(curve);
+
+    if (sr->best > 0) {
+        printf("Saturation: %.1lf/s per drive with p%g within %.1lf us, over %u rates in %s\n", sr->best,
+               sr->percentile, sr->limit / 1000.0, sr->tried, name);
+    } else {
+        printf("Saturation: no rate met p%g within %.1lf us, over %u rates in %s\n",
+               sr->percentile, sr->limit / 1000.0, sr->tried, name);
+    }
 
     return 0;
-}
\ No newline at end of file
+}
+
+/**
+ * Incredibly crappy function to parse arguments without any
+ * sort of error checking.
+ * 
+ * The error checking is meant to take place in the pyton
+ * front end for the arguments. Optional arguments are given
+ * as flags ahead of the positional ones.
+ */
+int 
+parse_args(int argc, char *argv[], struct bench_args *args)
+{
+    static struct option long_options[] = {
+        {"engine",  required_argument,  NULL, 'e'},
+        {"iodepth", required_argument,  NULL, 'q'},
+        {"consumers", required_argument, NULL, 't'},
+        {"queue",   required_argument,  NULL, 'Q'},
+        {"fixed",   no_argument,        NULL, 'f'},
+        {"direct",  no_argument,        NULL, 'd'},
+        {"hugepages", no_argument,      NULL, 'H'},
+        {"per-core", no_argument,       NULL, 'C'},
+        {"producer-cpus", required_argument, NULL, 'P'},
+        {"consumer-cpus", required_argument, NULL, 'W'},
+        {"timer-cpus", required_argument, NULL, 'T'},
+        {"numa",    required_argument,  NULL, 'N'},
+        {"seed",    required_argument,  NULL, 's'},
+        {"profile", required_argument,  NULL, 'p'},
+        {"arrival", required_argument,  NULL, 'a'},
+        {"script",  required_argument,  NULL, 'x'},
+        {"search",  required_argument,  NULL, 'R'},
+        {"slo",     required_argument,  NULL, 'L'},
+        {"compile", required_argument,  NULL, 'c'},
+        {"replay",  required_argument,  NULL, 'r'},
+        {"import",  required_argument,  NULL, 'i'},
+        {"speed",   required_argument,  NULL, 'S'},
+        {"verbose", no_argument,        NULL, 'v'},
+        {NULL,      0,                  NULL, 0}
+    };
+    int opt;
+
+    // Defaults for the optional arguments.
+    args->engine = IO_ENGINE_SYNC;
+    args->iodepth = 1;
+    args->consumers = 1;
+    args->lockfree = 1;
+    args->fixed = 0;
+    args->verbose = 0;
+    args->direct = 0;
+    args->hugepages = 0;
+    args->per_core = 0;
+    args->numa = NUMA_NONE;
+    memset(args->role_pinned, 0, sizeof args->role_pinned);
+    args->seed = (uint64_t)time(NULL) ^ ((uint64_t)getpid() << 32);
+    args->profile = NULL;
+    args->arrival = NULL;
+    args->script = NULL;
+    args->search = NULL;
+    args->slo = NULL;
+    args->compile = NULL;
+    args->replay = NULL;
+    args->import = NULL;
+    args->speed = 1;
+
+    while ((opt = getopt_long(argc, argv, "e:q:t:Q:fdHCP:W:T:N:s:p:a:x:R:L:c:r:i:S:v", long_options, NULL)) != -1) {
+        switch (opt) {
+        case 'e':
+            if (!strcmp(optarg, "uring")) {
+                args->engine = IO_ENGINE_URING;
+            } else if (!strcmp(optarg, "sync")) {
+                args->engine = IO_ENGINE_SYNC;
+            } else {
+                return -1;
+            }
+            break;
+        case 'q':
+            args->iodepth = atoi(optarg);
+            break;
+        case 't':
+            args->consumers = atoi(optarg);
+            break;
+        case 'Q':
+            if (!strcmp(optarg, "lockfree")) {
+                args->lockfree = 1;
+            } else if (!strcmp(optarg, "locking")) {
+                args->lockfree = 0;
+            } else {
+                return -1;
+            }
+            break;
+        case 'f':
+            args->fixed = 1;
+            break;
+        case 'd':
+            args->direct = 1;
+            break;
+        case 'H':
+            args->hugepages = 1;
+            break;
+        case 'C':
+            args->per_core = 1;
+            break;
+        case 'P':
+            args->role_pinned[ROLE_PRODUCER] = 1;
+            if (affinity_parse(optarg, &args->role_cpus[ROLE_PRODUCER])) {
+                return -1;
+            }
+            break;
+        case 'W':
+            args->role_pinned[ROLE_CONSUMER] = 1;
+            if (affinity_parse(optarg, &args->role_cpus[ROLE_CONSUMER])) {
+                return -1;
+            }
+            break;
+        case 'T':
+            args->role_pinned[ROLE_TIMER] = 1;
+            if (affinity_parse(optarg, &args->role_cpus[ROLE_TIMER])) {
+                return -1;
+            }
+            break;
+        case 'N':
+            args->numa = (!strcmp(optarg, "auto"))? NUMA_AUTO: atoi(optarg);
+            if (args->numa < NUMA_AUTO) {
+                return -1;
+            }
+            break;
+        case 's':
+            args->seed = strtoull(optarg, NULL, 0);
+            break;
+        case 'p':
+            args->profile = optarg;
+            break;
+        case 'a':
+            args->arrival = optarg;
+            break;
+        case 'x':
+            args->script = optarg;
+            break;
+        case 'R':
+            args->search = optarg;
+            break;
+        case 'L':
+            args->slo = optarg;
+            break;
+        case 'c':
+            args->compile = optarg;
+            break;
+        case 'r':
+            args->replay = optarg;
+            break;
+        case 'i':
+            args->import = optarg;
+            break;
+        case 'S':
+            args->speed = atof(optarg);
+            break;
+        case 'v':
+            args->verbose = 1;
+            break;
+        default:
+            return -1;
+        }
+    }
+
+    // Importing a text trace needs nothing but the trace to
+    // compile it into.
+    if (args->import) {
+        return (args->compile)? 0: -1;
+    }
+
+    // A trace is a single stream of arrivals, which cannot be
+    // split over shards.
+    if (args->per_core && (args->compile || args->replay)) {
+        return -1;
+    }
+
+    // A script brings the profiles, arrivals and durations of
+    // its phases along, and goes with neither kind of trace.
+    if (args->script && (args->profile || args->arrival || args->compile || args->replay)) {
+        return -1;
+    }
+
+    // A saturation search picks the Poisson rates it runs at
+    // itself, towards its latency target.
+    if ((!args->search != !args->slo) ||
+        (args->search && (args->script || args->arrival || args->compile || args->replay))) {
+        return -1;
+    }
+
+    // Shift the positional arguments so that they line up
+    // with the argument enumeration. A profile file takes the
+    // place of the probabilities and sizes, a script that of
+    // everything but the paths.
+    argc -= optind - ((args->script)? PATH: (args->profile)? TIMER: 1);
+    argv += optind - ((args->script)? PATH: (args->profile)? TIMER: 1);
+    if (argc != ARG_COUNT || args->iodepth == 0 || args->consumers == 0) {
+        return -1;
+    }
+    args->path = argv[PATH];
+    if (args->script) {
+        return 0;
+    }
+
+    if (!args->profile) {
+        // Get Probabilities
+        args->prob[0] = atof(argv[RREAD_PROB]);
+        args->prob[1] = atof(argv[RWRITE_PROB]);
+        args->prob[2] = atof(argv[SREAD_PROB]);
+        args->prob[3] = atof(argv[SWRITE_PROB]);
+
+        // Get Sizes
+        args->sz[0] = atoll(argv[RREAD_SZ]);
+        args->sz[1] = atoll(argv[RWRITE_SZ]);
+        args->sz[2] = atoll(argv[SREAD_SZ]);
+        args->sz[3] = atoll(argv[SWRITE_SZ]);
+    }
+
+    // Get Miscellaneous
+    args->timer = atol(argv[TIMER]);
+    args->lambda = atof(argv[LAMBDA]);
+
+    return 0;
+}
+
+/**
+ * Main function is used to setup the threads and execute them.
+ * From there on, it basically waits until the timer returns, after
+ * which it frees up the used memory and exits.
+ * 
+ * Every drive in the comma separated list of paths gets a
+ * pipeline of its own, or one per CPU each on a share of the
+ * drive. All pipelines run on a common clock and are stopped by
+ * the same timer, but otherwise share nothing.
+ */
+int 
+main(int argc, char *argv[])
+{
+    struct bench_args args_data;
+    struct producer_stats *total_stats;
+    struct data_collection *total;
+    timeline *total_timeline;
+    struct phase *phases;
+    struct work_profile *profile;
+    search sr;
+    struct target *targets, *tg;
+    struct shard *sh;
+    cirq **workloads;
+    trace *replay;
+    char *paths, *path, *save, *ofile_name;
+    char suffix[PHASE_NAME_LEN + 8];
+    cpu_set_t allowed, *tcpus;
+    uring *ring;
+    uint64_t start, r;
+    uint32_t count, peers, rank, t, u, s, g, k, phase_count;
+    int ret;
+
+    if (parse_args(argc, argv, &args_data)) {
+        printf("Not Enough Args!\n");
+        printf("Usage: %s [--engine sync|uring] [--iodepth N] [--consumers N | --per-core]\n"
+               "       [--queue locking|lockfree] [--fixed] [--direct] [--hugepages]\n"
+               "       [--producer-cpus LIST] [--consumer-cpus LIST] [--timer-cpus LIST]\n"
+               "       [--numa NODE|auto]\n"
+               "       [--seed N] [--compile TRACE | --replay TRACE [--speed X]] [--verbose]\n"
+               "       [--arrival mmpp:RATE@DWELL,... | onoff:RATE:ON:OFF | curve:FILE]\n"
+               "       [--search step:START:STEP[:STEPS] | binary:LOW:HIGH[:ROUNDS] --slo PCT:US]\n"
+               "       {RREAD_PROB RWRITE_PROB SREAD_PROB SWRITE_PROB\n"
+               "        RREAD_SZ RWRITE_SZ SREAD_SZ SWRITE_SZ | --profile FILE}\n"
+               "       TIMER LAMBDA PATH[,PATH...]\n"
+               "       %s [OPTIONS] --script FILE PATH[,PATH...]\n"
+               "       %s --import TEXT --compile TRACE\n", argv[0], argv[0], argv[0]);
+        return -1;
+    }
+    if (args_data.import) {
+        return _import_trace(args_data.import, args_data.compile);
+    }
+    printf("Seed: %lu\n", args_data.seed);
+
+    nano_time_init();
+    printf("Time Source: %s, %lu ns overhead\n",
+           (nano_time_source.tsc)? "invariant TSC": "CLOCK_MONOTONIC_RAW", nano_time_source.overhead);
+
+    // Consumers of the io_uring engine bound their waits, which
+    // not every kernel offering io_uring can do.
+    if (args_data.engine == IO_ENGINE_URING) {
+        ring = uring_create(1);
+        if (!ring) {
+            printf("The io_uring engine needs io_uring with IORING_FEAT_EXT_ARG (Linux 5.11)\n");
+            return -1;
+        }
+        uring_free(ring);
+    }
+
+    /*
+     * A script gives the phases of the run, otherwise the run is
+     * a single phase. Its profile is built out of the profile
+     * file, or else out of the arguments provided. For more
+     * information on how classes are drawn, refer to
+     * "work_profile.h", and on scripts to "script/script.h".
+     */
+    phases = calloc(MAX_PHASES, sizeof(*phases));
+    assert(phases != NULL);
+    if (args_data.script) {
+        ret = script_load(args_data.script, phases, &phase_count);
+        if (ret < 0) {
+            printf("Could not open script %s\n", args_data.script);
+            return -1;
+        } else if (ret > 0) {
+            printf("Malformed line %d in script %s\n", ret, args_data.script);
+            return -1;
+        }
+        args_data.timer = script_duration(phases, phase_count);
+        for (k = 0; k < phase_count; k++) {
+            printf("Phase %u: %s, %ld seconds, %u classes, %.1lf/s on average\n", k, phases[k].name,
+                   phases[k].duration, phases[k].profile.count,
+                   arrival_mean_rate(&phases[k].arrival, phases[k].duration));
+        }
+    } else {
+        phase_count = 1;
+        snprintf(phases[0].name, sizeof phases[0].name, "run");
+        phases[0].duration = args_data.timer;
+        profile = &phases[0].profile;
+
+        work_profile_init(profile);
+        if (args_data.profile) {
+            ret = work_profile_load(profile, args_data.profile);
+            if (ret < 0) {
+                printf("Could not open profile %s\n", args_data.profile);
+                return -1;
+            } else if (ret > 0) {
+                printf("Malformed line %d in profile %s\n", ret, args_data.profile);
+                return -1;
+            }
+        } else {
+            /*
+             * Every class has to make it into the profile, as the
+             * classes are referred to by their IO_* index, by the
+             * statistics files and by imported traces alike.
+             */
+            for (k = 0; k < IO_MAX_TASKS; k++) {
+                if (work_profile_add(profile, default_classes[k], (k == IO_RWRITE || k == IO_SWRITE),
+                                     (k >= IO_SREAD)? ACCESS_SEQUENTIAL: ACCESS_RANDOM,
+                                     args_data.prob[k], args_data.sz[k])) {
+                    printf("Class %s needs a weight of at least 0 and, unless its weight is 0, a size\n",
+                           default_classes[k]);
+                    return -1;
+                }
+            }
+        }
+        if (work_profile_finish(profile)) {
+            printf("The profile has no classes with any weight\n");
+            return -1;
+        }
+
+        /*
+         * Arrivals follow a Poisson process at the rate LAMBDA
+         * gives, unless another process is asked for, in which
+         * case LAMBDA is ignored. For more information on the
+         * processes, refer to "arrival/arrival.h".
+         */
+        if (args_data.arrival) {
+            if (arrival_parse(&phases[0].arrival, args_data.arrival)) {
+                printf("Invalid arrival process %s\n", args_data.arrival);
+                return -1;
+            }
+            printf("Arrivals: %s, %.1lf/s on average\n", args_data.arrival,
+                   arrival_mean_rate(&phases[0].arrival, args_data.timer));
+        } else {
+            arrival_poisson(&phases[0].arrival, 1 / args_data.lambda);
+        }
+    }
+
+    if (args_data.search) {
+        if (search_parse(&sr, args_data.search, args_data.slo)) {
+            printf("Invalid search %s or target %s\n", args_data.search, args_data.slo);
+            return -1;
+        }
+        printf("Search: %s for p%g within %.1lf us, %ld seconds per rate\n", args_data.search,
+               sr.percentile, sr.limit / 1000.0, args_data.timer);
+    }
+
+    /*
+     * Open every drive first as direct I/O dictates the alignment
+     * of every request on it.
+     */
+    paths = strdup(args_data.path);
+    assert(paths != NULL);
+    for (count = 1, path = paths; (path = strchr(path, ',')) != NULL; count++, path++);
+    targets = calloc(count, sizeof(*targets));
+    assert(targets != NULL);
+
+    count = 0;
+    for (path = strtok_r(paths, ",", &save); path; path = strtok_r(NULL, ",", &save)) {
+        _target_open(&targets[count++], path, &args_data, phases, phase_count);
+    }
+    assert(count > 0);
+
+    /*
+     * Workers of a drive placed on a NUMA node, either the one
+     * given or the one owning the drive, may only run on the CPUs
+     * of that node. The other workers may run anywhere they are
+     * allowed to.
+     */
+    if (sched_getaffinity(0, sizeof allowed, &allowed)) {
+        CPU_ZERO(&allowed);
+        CPU_SET(0, &allowed);
+    }
+    tcpus = malloc(sizeof(*tcpus) * count);
+    assert(tcpus != NULL);
+    for (t = 0; t < count; t++) {
+        tg = &targets[t];
+        tg->node = (args_data.numa == NUMA_AUTO)? affinity_drive_node(tg->fd): args_data.numa;
+        _target_cpus(tg, &allowed, &tcpus[t]);
+        if (args_data.numa != NUMA_NONE) {
+            printf("NUMA: %s on node %d, %d CPUs\n", tg->path, tg->node, CPU_COUNT(&tcpus[t]));
+        }
+    }
+
+    /*
+     * In the per core mode the CPUs of a drive are split evenly
+     * amongst the drives which may run on the same CPUs, and every
+     * drive is split into as many shares as it gets CPUs. Each
+     * share is worked on by a producer and a single consumer
+     * pinned to its CPU, and gets an equal share of the arrival
+     * rate.
+     */
+    for (t = 0, g = 0; t < count; t++) {
+        tg = &targets[t];
+        tg->shard_count = 1;
+        rank = 0;
+        if (args_data.per_core) {
+            for (u = 0, peers = 0; u < count; u++) {
+                if (CPU_EQUAL(&tcpus[u], &tcpus[t])) {
+                    rank += (u < t);
+                    peers++;
+                }
+            }
+            tg->shard_count = MAX(CPU_COUNT(&tcpus[t]) / peers, 1);
+            printf("Per Core: %u producer and consumer pairs for %s\n", tg->shard_count, tg->path);
+        }
+        tg->shards = calloc(tg->shard_count, sizeof(*tg->shards));
+        assert(tg->shards != NULL);
+
+        for (s = 0; s < tg->shard_count; s++) {
+            tg->shards[s].cpu = (args_data.per_core)? _nth_cpu(&tcpus[t], rank * tg->shard_count + s): -1;
+            tg->shards[s].consumer_count = (args_data.per_core)? 1: args_data.consumers;
+        }
+        g += tg->shard_count;
+    }
+    workloads = malloc(sizeof(*workloads) * g);
+    assert(workloads != NULL);
+
+    /*
+     * A saturation search runs the pipelines once for every
+     * rate it tries instead, and its curve is all it reports.
+     */
+    if (args_data.search) {
+        ofile_name = (count > 1)? strdup(AGGREGATE_NAME ".search.csv"):
+                                  _output_file_name(targets[0].path, ".search.csv");
+        assert(ofile_name != NULL);
+        ret = _search(&sr, ofile_name, targets, count, tcpus, &args_data, workloads);
+        if (ret) {
+            printf("Could not write the curve %s\n", ofile_name);
+        }
+        for (t = 0; t < count; t++) {
+            close(targets[t].fd);
+            free(targets[t].shards);
+            free(targets[t].phases);
+            free(targets[t].bases);
+        }
+        free(ofile_name);
+        script_free(phases, phase_count);
+        free(phases);
+        free(workloads);
+        free(tcpus);
+        free(targets);
+        free(paths);
+        return ret;
+    }
+
+    for (t = 0, g = 0; t < count; g += targets[t++].shard_count) {
+        _target_producers(&targets[t], args_data.seed, g);
+    }
+
+    /*
+     * Compiling a trace is all there is to do in case one is
+     * asked for, and it is compiled for the first drive. A trace
+     * to replay instead is shared by every drive, so it has to
+     * fit each of them, and with direct I/O it has to be aligned
+     * for each of them. Neither goes with the per core mode, so
+     * every drive has a single shard here.
+     */
+    if (args_data.compile) {
+        ret = _compile_trace(&targets[0].shards[0].pargs, args_data.compile, targets[0].align,
+                             args_data.seed, args_data.timer);
+        for (t = 0; t < count; t++) {
+            close(targets[t].fd);
+            free(targets[t].shards[0].pargs.stats);
+            free(targets[t].shards);
+            free(targets[t].phases);
+            free(targets[t].bases);
+        }
+        script_free(phases, phase_count);
+        free(phases);
+        free(workloads);
+        free(tcpus);
+        free(targets);
+        free(paths);
+        return ret;
+    }
+
+    replay = NULL;
+    if (args_data.replay) {
+        replay = trace_open(args_data.replay);
+        if (!replay) {
+            printf("Invalid trace %s\n", args_data.replay);
+            return -1;
+        }
+        for (t = 0; t < count; t++) {
+            tg = &targets[t];
+            sh = &tg->shards[0];
+            if (replay->header->drive_size > tg->drive_size || replay->header->align % tg->align) {
+                printf("Trace %s was compiled for a %lu byte drive aligned to %lu bytes, unfit for %s\n",
+                       args_data.replay, replay->header->drive_size, replay->header->align, tg->path);
+                return -1;
+            }
+            sh->pargs.trace = replay;
+            sh->pargs.speed = args_data.speed;
+            sh->pargs.stats[0].rate = sh->pargs.speed * replay->header->count / (replay->header->duration / 1000000000.0);
+        }
+        for (r = 0; r < replay->header->count; r++) {
+            if (replay->records[r].task >= phases[0].profile.count) {
+                printf("Trace %s has classes the profile does not have\n", args_data.replay);
+                return -1;
+            }
+            if (replay->records[r].write != phases[0].profile.classes[replay->records[r].task].write) {
+                printf("Trace %s has requests which go the other way from their class in the profile\n",
+                       args_data.replay);
+                return -1;
+            }
+        }
+        printf("Replaying %lu arrivals from %s (seed %lu)\n", replay->header->count,
+               args_data.replay, replay->header->seed);
+    }
+
+    for (t = 0, g = 0; t < count; g += targets[t++].shard_count) {
+        _target_pipelines(&targets[t], &args_data, replay, &workloads[g]);
+    }
+    start = _run(targets, count, tcpus, &args_data, workloads);
+
+    /*
+     * Every phase of a run with several of them is reported on
+     * and written to a statistics file of its own. The drive is
+     * only flushed once the last phase is over, so the sync time
+     * goes to the last phase.
+     */
+    for (t = 0; t < count; t++) {
+        tg = &targets[t];
+        if (count > 1) {
+            printf("\n[%u] %s\n", t, tg->path);
+        }
+        for (k = 0; k < tg->phase_count; k++) {
+            if (tg->phase_count > 1) {
+                printf("\n(%u) Phase %s, %ld seconds\n", k, tg->phases[k].name, tg->phases[k].duration);
+            }
+            _output_phase_suffix(suffix, sizeof suffix, tg->phases, tg->phase_count, k);
+            ofile_name = _output_file_name(tg->path, suffix);
+            _output_results(ofile_name, (k == tg->phase_count - 1)? tg->fd: -1, &tg->data[tg->bases[k]],
+                            &tg->phases[k].profile, &tg->stats[k]);
+            free(ofile_name);
+        }
+        for (s = 0; s < tg->shard_count; s++) {
+            _account_work_items(tg->shards[s].items, tg->shards[s].workload);
+        }
+
+        // The latencies of every second go to a CSV of their own.
+        ofile_name = _output_file_name(tg->path, ".csv");
+        if (timeline_write(tg->timeline, ofile_name)) {
+            printf("Could not write the timeline %s\n", ofile_name);
+        }
+        free(ofile_name);
+    }
+
+    // The aggregate of the whole array sums up every drive.
+    if (count > 1) {
+        total = _create_data(targets[0].bases[phase_count]);
+        total_stats = calloc(phase_count, sizeof(*total_stats));
+        assert(total_stats != NULL);
+        total_timeline = timeline_create(start, args_data.timer + TIMELINE_SLACK);
+        assert(total_timeline != NULL);
+        for (t = 0; t < count; t++) {
+            _merge_data(total, targets[t].data, targets[0].bases[phase_count]);
+            timeline_merge(total_timeline, targets[t].timeline);
+            for (k = 0; k < phase_count; k++) {
+                _merge_producer(&total_stats[k], &targets[t].stats[k]);
+            }
+        }
+
+        printf("\n[*] Aggregate of %u drives\n", count);
+        for (k = 0; k < phase_count; k++) {
+            if (phase_count > 1) {
+                printf("\n(%u) Phase %s, %ld seconds\n", k, phases[k].name, phases[k].duration);
+            }
+            _output_phase_suffix(suffix, sizeof suffix, phases, phase_count, k);
+            ofile_name = malloc(strlen(AGGREGATE_NAME) + strlen(suffix) + 1);
+            assert(ofile_name != NULL);
+            strcpy(ofile_name, AGGREGATE_NAME);
+            strcat(ofile_name, suffix);
+            _output_results(ofile_name, -1, &total[targets[0].bases[k]], &phases[k].profile, &total_stats[k]);
+            free(ofile_name);
+        }
+        if (timeline_write(total_timeline, AGGREGATE_TIMELINE)) {
+            printf("Could not write the timeline %s\n", AGGREGATE_TIMELINE);
+        }
+        timeline_free(total_timeline);
+        free(total_stats);
+        free(total);
+    }
+
+    for (t = 0; t < count; t++) {
+        tg = &targets[t];
+        _target_release(tg);
+        close(tg->fd);
+        free(tg->shards);
+        free(tg->phases);
+        free(tg->bases);
+    }
+    if (replay) {
+        trace_free(replay);
+    }
+    script_free(phases, phase_count);
+    free(phases);
+    free(workloads);
+    free(tcpus);
+    free(targets);
+    free(paths);
+
+    return 0;
+}
@@ -1,7 +1,11 @@
 /**
  * Header for describing the architecture model
- * of the benchmark. Each process handles a single
- * producer and consumer working on a single drive.
+ * of the benchmark. Each drive is handled by its
+ * own pipeline of a single producer and a pool of
+ * consumers, or by one producer and consumer pair
+ * per core, each on a share of the drive. A process
+ * can drive several drives, whose pipelines share
+ * nothing but start and stop together.
  * 
  * Author: Yash Gupta <yash_gupta12@live.com>
  * Copyright: Yash Gupta
@@ -10,10 +14,19 @@
  */
 #include "vector/vector.h"
 #include "cirq/cirq.h"
+#include "bufpool/bufpool.h"
+#include "histogram/histogram.h"
+#include "rng/rng.h"
+#include "trace/trace.h"
+#include "timeline/timeline.h"
+#include "arrival/arrival.h"
+#include "script/script.h"
 #include "work_profile.h"
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
 #include <pthread.h>
+#include <time.h>
 
 #ifndef _MODEL_H_
 #define _MODEL_H_
@@ -21,26 +34,42 @@
 //
 // Macros
 //
-// Total number of data points.
-//  
-#define MAX_DATA_POINTS     IO_MAX_TASKS
+// Requests are also accounted by op and by size, in buckets
+// up to each power of two from 4KiB to 4MiB and one beyond.
+#define SIZE_BUCKETS        12
+#define SIZE_BUCKET_SHIFT   12
+#define SIZE_STATS          (2 * SIZE_BUCKETS)
+
+// Skewed offsets are drawn in blocks of this size, or of the
+// alignment of the profile if it is larger.
+#define OFFSET_BLOCK        4096
+
+// Work items are generated a column at a time over chunks of
+// up to this many items.
+#define GENERATE_CHUNK      64
 
 //
 // Enumerations
 //
-// Task Identifier
+// Classes of the default profile, built out of the
+// positional arguments. Imported traces use these too.
 enum iotask {
     IO_RREAD = 0,
     IO_RWRITE,
     IO_SREAD,
     IO_SWRITE,
 
-    // This value defines the maximum number of tasks
-    // we have. Hence, this can be used as the value for
-    // the number of data points we need to collect.
+    // This value defines the number of classes of the
+    // default profile.
     IO_MAX_TASKS
 };
 
+// I/O Engines
+enum io_engine {
+    IO_ENGINE_SYNC = 0,
+    IO_ENGINE_URING
+};
+
 //
 // Structures
 //
@@ -48,23 +77,98 @@ enum iotask {
 struct work_item {
     /*
      * Each work item describes a single task the consumer needs 
-     * to perform. A task simply consists of whether the consumer 
-     * needs to (read, write or stop), an offset to work on and
-     * the length for the required task. A sequence number for the
-     * task is also provided.
+     * to perform. A task simply consists of the class of the
+     * operation, whether the consumer needs to read or write, an
+     * offset to work on and the length for the required task. A
+     * sequence number for the task is also provided.
+     * 
+     * The item is stamped with the time it was meant to arrive
+     * at, so that time spent waiting on a backed up queue counts
+     * towards its latency, and with the phase of the run it
+     * arrived in, which its class belongs to.
      */
 
     uint64_t sequence;
     uint64_t offset;
     uint64_t length;
-    enum iotask task;
+    uint32_t task;
+    uint32_t phase;
+    uint8_t write;
+    uint64_t arrival;
+};
+
+// Per producer state of the workload generator. Offsets
+// are generated relative to the base of its share of the drive,
+// every stream of a sequential class carries on from a cursor of
+// its own within its region and skewed random classes draw from
+// a sampler of their own.
+struct work_generator {
+    rng rng;
+    uint64_t base;
+    uint64_t sequence;
+    uint64_t cursors[MAX_CLASSES][MAX_STREAMS];
+    uint64_t regions[MAX_CLASSES];
+    struct offset_sampler offsets[MAX_CLASSES];
+};
+
+// Pool of work items.
+struct work_pool {
+    /*
+     * Every work item in flight, whether generated but not yet
+     * dequeued or dequeued but not yet completed, is taken out
+     * of the slab. The pool needs to hold at least as many items
+     * as the queue and all the consumers together can hold, plus
+     * the batch of items the producer is generating.
+     */
+
+    struct work_item *slab;
+    uint64_t count;
+    cirq *free;
 };
 
 // Statistical Collection
 struct data_collection {
     uint64_t total_operations;
-    double total_time_consumed;
+    uint64_t total_bytes;
+    uint64_t total_time_consumed;
     double avg_time_consumed;
+
+    /*
+     * Distributions of latencies in nanoseconds. The service
+     * time covers the I/O itself, the queueing delay runs from
+     * the intended arrival of an item until the I/O is issued,
+     * and the response time is the sum of both.
+     */
+    histogram service;
+    histogram queueing;
+    histogram response;
+};
+
+/*
+ * Statistics are kept in a single array per consumer, in a
+ * block per phase of the run. The classes of the profile of the
+ * phase come first, followed by SIZE_BUCKETS buckets for reads
+ * and then SIZE_BUCKETS for writes. The block of phase i starts
+ * at bases[i], bases[phases] being the length of the array.
+ */
+
+// Arrivals of a producer over a single phase.
+struct producer_stats {
+    // Mean arrival rate the producer was asked for.
+    double rate;
+
+    /*
+     * Arrivals which found the queue full, or were already
+     * overdue because the producer was held up by a full
+     * queue, are counted as deferred.
+     */
+    uint64_t arrivals;
+    uint64_t deferred;
+
+    // Arrivals actually issued and the time taken to do so,
+    // which give the achieved arrival rate.
+    uint64_t issued;
+    double elapsed;
 };
 
 // Thread arguments
@@ -74,13 +178,45 @@ struct thread_args_consumer {
      * have a brain dead consumer whose job is to simply
      * dequeue an item and execute the task. All it requires
      * is the file descriptor and a link to the shared queue along
-     * with all drive statistics.
+     * with its own drive statistics, per class and per size
+     * bucket. Several consumers can share a single queue, their
+     * statistics are merged at the end of the run.
      */
 
+    uint32_t id;
     int  fd;
-    char *file_name;
     cirq *workload;
-    struct data_collection data[MAX_DATA_POINTS];
+    struct work_pool *items;
+    struct data_collection *data;
+    uint32_t *bases;
+    uint32_t phases;
+
+    // Latencies of every second of the run, recorded into the
+    // timeline of the drive, from the common start of the run on.
+    timeline *timeline;
+    timeline_recorder *recorder;
+
+    /*
+     * The I/O engine decides how the dequeued items are
+     * issued. The synchronous engine issues a single blocking
+     * call at a time while the io_uring engine keeps up to
+     * iodepth requests in flight, each with a buffer large
+     * enough for the largest request in the profile.
+     */
+    enum io_engine engine;
+    uint32_t iodepth;
+    uint32_t batch;
+    uint8_t fixed;
+    uint8_t verbose;
+    uint64_t max_io_size;
+
+    /*
+     * I/O buffers come out of a pool shared by all consumers
+     * which is allocated once before the run. Each consumer owns
+     * iodepth consecutive buffers starting at buf_base.
+     */
+    bufpool *buffers;
+    uint64_t buf_base;
 };
 
 struct thread_args_producer {
@@ -91,93 +227,425 @@ struct thread_args_producer {
      * the distribution of the workload.
      */
 
-    double rate;
     long int drive_size;
     struct work_profile *profile;
+    struct work_generator gen;
+
+    // Process the arrivals follow, a share of that of the
+    // phase for each of shares producers of the drive.
+    arrival arrival;
+    uint32_t shares;
+
+    /*
+     * Phases of the run, which follow each other back to back
+     * on the common clock, and the statistics of each. The
+     * profile and arrivals of the producer are those of the
+     * current phase, which ends at phase_end.
+     */
+    struct phase *phases;
+    uint32_t phase_count;
+    uint32_t phase;
+    uint64_t phase_end;
+    struct producer_stats *stats;
+
+    // Cursors of the sequential streams as each phase but the
+    // last ended, for a later phase to carry on with.
+    uint64_t (*cursors)[MAX_CLASSES][MAX_STREAMS];
+
+    // Time the run starts at, common to every pipeline, and
+    // whether the producer may spin while waiting for it, which
+    // it may not when it shares its CPU with its consumers.
+    uint64_t start;
+    uint8_t spin;
+
+    // Compiled trace to replay instead, if any, and the speed
+    // to replay it at (0 as fast as possible).
+    trace *trace;
+    double speed;
+    struct work_pool *items;
     cirq *workload;
 };
 
 struct thread_args_timer {
     /*
      * The timer thread is used to time a certain benchmark
-     * session. It conveniently kills the producer and the
-     * consumer thread.
+     * session. It conveniently stops the producer and the
+     * consumer threads of every pipeline by closing the queues
+     * they share.
      */
 
-    pthread_t *producer;
-    pthread_t *consumer;
+    cirq **workloads;
+    uint32_t count;
     long int timer;
+    uint64_t start;
+};
+
+// Pipeline working on a share of a drive.
+struct shard {
+    /*
+     * Every shard gets a queue, a pool of work items and a
+     * pool of buffers of its own, along with its producer and
+     * consumers, so that shards never contend with each other.
+     * Its threads are pinned to a single CPU, if any (-1).
+     */
+
+    int32_t cpu;
+    uint32_t consumer_count;
+
+    cirq *workload;
+    struct work_pool *items;
+    bufpool *buffers;
+
+    pthread_t producer;
+    pthread_t *consumers;
+    struct thread_args_producer pargs;
+    struct thread_args_consumer *cargs;
+};
+
+// A single drive and the shards working on it.
+struct target {
+    /*
+     * The statistics of every shard of a drive are summed up
+     * into those of the drive, which are in turn only summed
+     * up for the aggregate results.
+     */
+
+    char *path;
+    int fd;
+    uint64_t drive_size;
+    uint64_t align;
+
+    // Phases of the run, their profiles aligned for the drive,
+    // and the block of the statistics of each phase.
+    struct phase *phases;
+    uint32_t phase_count;
+    uint32_t *bases;
+
+    // NUMA node the workers and memory of the drive are
+    // placed on, -1 for none.
+    int32_t node;
+
+    struct shard *shards;
+    uint32_t shard_count;
+
+    struct producer_stats *stats;
+    struct data_collection *data;
+    timeline *timeline;
 };
 
 /**
- * This function is used to generate a workload based on a 
- * workload profile. It uses stubs to generate the actual
- * workload. It is the callers responsibility to free this
- * workload.
+ * Create a pool of work items. All the items live in a single
+ * slab and are handed out and returned through a ring of free
+ * items, so generating and retiring work never calls into the
+ * allocator.
  * 
- * @param profile       The profile to generate a workload on.
- * @param drive_size    The size of the drive.
+ * @param count         Count of items in the pool.
+ * @param type          Type of the free item ring.
  * 
- * @return A valid workitem
+ * @return A work item pool.
  * @return NULL         Malloc error
  */
-static struct work_item*
-_generate_work_item(struct work_profile *profile, uint64_t drive_size)
+static struct work_pool*
+_work_pool_create(uint64_t count, uint8_t type)
 {
-    static uint64_t sequence = 0;
-    static uint64_t sread_offset = 0;
-    static uint64_t swrite_offset = 0;
+    struct work_pool *pool;
+    uint64_t i;
 
-    struct work_item *item;
-    long int task;
-
-    /*
-     * It is possible in case the consumer cannot function
-     * as fast as the producer that valgrind reports a memory.
-     * THAT is okay \_||_/.
-     */
-    
-    item = malloc(sizeof *item);
-    if (!item) {
+    pool = malloc(sizeof *pool);
+    if (!pool) {
         return NULL;
     }
 
-    item->sequence = sequence++;
-    task = (rand() % 100) + 1;
+    pool->count = count;
+    pool->slab = calloc(count, sizeof(*pool->slab));
+    if (!pool->slab) {
+        goto slab_alloc_fail;
+    }
+
+    // The ring holds one less item than its length.
+    pool->free = cirq_create(count + 1, type);
+    if (!pool->free) {
+        goto ring_alloc_fail;
+    }
+
+    for (i = 0; i < count; i++) {
+        cirq_put(pool->free, &pool->slab[i]);
+    }
+
+    return pool;
+
+ring_alloc_fail:
+    free(pool->slab);
+
+slab_alloc_fail:
+    free(pool);
+
+    return NULL;
+}
+
+/**
+ * Deallocate a pool of work items.
+ * 
+ * @param pool          The pool to deallocate.
+ */
+static void
+_work_pool_free(struct work_pool *pool)
+{
+    cirq_free(pool->free);
+    free(pool->slab);
+    free(pool);
+}
+
+/**
+ * Reset a workload generator for a share of a drive, split
+ * the share into the regions of the streams of every class and
+ * prepare the offset samplers of the classes over it. The random
+ * stream is left to the caller to seed.
+ * 
+ * @param gen           The generator to reset.
+ * @param profile       The profile to generate a workload on.
+ * @param base          Offset of the share of the drive.
+ * @param drive_size    The size of the share of the drive.
+ */
+static void
+_work_generator_init(struct work_generator *gen, struct work_profile *profile, uint64_t base,
+                     uint64_t drive_size)
+{
+    uint64_t block = (profile->align > OFFSET_BLOCK)? profile->align: OFFSET_BLOCK;
+    struct work_class *c;
+    uint32_t i, s;
+
+    memset(gen, 0, sizeof *gen);
+    gen->base = base;
+    for (i = 0; i < profile->count; i++) {
+        c = &profile->classes[i];
+        offset_sampler_init(&gen->offsets[i], &c->offset, drive_size, block);
+
+        gen->regions[i] = drive_size / c->streams;
+        gen->regions[i] -= gen->regions[i] % profile->align;
+        for (s = 0; s < c->streams; s++) {
+            gen->cursors[i][s] = s * gen->regions[i];
+        }
+    }
+}
+
+/**
+ * Acquire the index of the size bucket of a request among the
+ * statistics of a profile.
+ *
+ * @param classes       Count of classes of the profile.
+ * @param write         The request writes.
+ * @param length        Length of the request.
+ *
+ * @return Index of the bucket.
+ */
+static inline uint32_t
+_size_bucket(uint32_t classes, uint8_t write, uint64_t length)
+{
+    uint32_t bucket;
+
+    bucket = (length <= (1ULL << SIZE_BUCKET_SHIFT))? 0: 64 - __builtin_clzll(length - 1) - SIZE_BUCKET_SHIFT;
+    if (bucket >= SIZE_BUCKETS) {
+        bucket = SIZE_BUCKETS - 1;
+    }
+
+    return classes + (write? SIZE_BUCKETS: 0) + bucket;
+}
+
+/**
+ * Acquire the offset of the next request of a sequential class
+ * and move the stream it goes to on past it. The request is
+ * trimmed to the end of the region of the stream, so that no
+ * stream ever touches the region of another.
+ * 
+ * @param gen           The generator of the class.
+ * @param c             The class.
+ * @param task          Index of the class in its profile.
+ * @param length        Length of the request, trimmed in place.
+ * @param drive_size    The size of the share of the drive.
+ * 
+ * @return Offset of the request within the share.
+ */
+static inline uint64_t
+_sequential_offset(struct work_generator *gen, struct work_class *c, uint32_t task,
+                   uint64_t *length, uint64_t drive_size)
+{
+    uint64_t *cursor, offset, next, end;
+    uint32_t stream;
+
+    stream = (c->streams > 1)? rng_bounded(&gen->rng, c->streams): 0;
+    cursor = &gen->cursors[task][stream];
+    offset = *cursor;
+
+    // A stream wraps around to the start of its region, the
+    // last one runs up to the end of the drive.
+    end = (stream == c->streams - 1)? drive_size: (stream + 1) * gen->regions[task];
+    if (end - offset < *length) {
+        *length = end - offset;
+    }
+    next = offset + ((c->stride)? c->stride: *length);
+    *cursor = (next >= end)? stream * gen->regions[task]: next;
+
+    return offset;
+}
+
+/**
+ * This function is used to generate a workload based on a 
+ * workload profile. It uses stubs to generate the actual
+ * workload into an item acquired from a work item pool.
+ * 
+ * @param item          The item to fill in.
+ * @param profile       The profile to generate a workload on.
+ * @param drive_size    The size of the share of the drive.
+ * @param gen           Generator of the calling thread.
+ * 
+ * @return The same workitem
+ */
+static struct work_item*
+_generate_work_item(struct work_item *item, struct work_profile *profile, uint64_t drive_size,
+                    struct work_generator *gen)
+{
+    struct work_class *c;
+
+    item->sequence = gen->sequence++;
+    item->task = work_profile_sample(profile, &gen->rng);
+    c = &profile->classes[item->task];
 
     /*
-     * Assign a workload based on the cumulative probability
-     * distribution of the workloads. In case the offset we get
-     * is such that size of io > drive_size - offset, then we
-     * trim the IO size until the end of the drive. This is the
-     * simulation of most industry class workloads.
+     * Assign a workload of the class drawn out of the profile.
+     * In case the offset we get is such that size of io >
+     * drive_size - offset, then we trim the IO size until the
+     * end of the drive. This is the simulation of most industry
+     * class workloads.
+     * 
+     * Sizes are rounded up to the profile alignment once drawn
+     * and random offsets are aligned down to it, which keeps
+     * sequential offsets aligned as well.
      */
 
-    if (task <= profile->rread_prob) {
-        item->task = IO_RREAD;
-        item->length = profile->rread_sz;
-        item->offset = rand() % drive_size;
-    } else if (task <= profile->rwrite_prob) {
-        item->task = IO_RWRITE;
-        item->length = profile->rwrite_sz;
-        item->offset = rand() % drive_size;
-    } else if (task <= profile->sread_prob) {
-        item->task = IO_SREAD;
-        item->length = profile->sread_sz;
-        item->offset = sread_offset;
-        sread_offset = (sread_offset + item->length >= drive_size)? 0: sread_offset + item->length;
-    } else if (task <= profile->swrite_prob) {
-        item->task = IO_SWRITE;
-        item->length = profile->swrite_sz;
-        item->offset = swrite_offset;
-        swrite_offset = (swrite_offset + item->length >= drive_size)? 0: swrite_offset + item->length;
+    item->write = c->write;
+    item->length = work_size_sample(&c->size, &gen->rng);
+    item->length += (profile->align - item->length % profile->align) % profile->align;
+    if (c->access == ACCESS_RANDOM && c->offset.distribution != OFFSET_UNIFORM) {
+        item->offset = offset_sampler_draw(&gen->offsets[item->task], &gen->rng);
+    } else if (c->access == ACCESS_RANDOM) {
+        item->offset = rng_bounded(&gen->rng, drive_size);
+        item->offset -= item->offset % profile->align;
+    } else {
+        item->offset = _sequential_offset(gen, c, item->task, &item->length, drive_size);
     }
 
     if ((drive_size - item->offset) < item->length) {
         item->length = drive_size - item->offset;
     }
+    item->offset += gen->base;
 
     return item;
 }
 
+/**
+ * Generate a workload into each of count items, as a producer
+ * issuing a batch of arrivals does. Rather than one item after
+ * the other, the items are generated a field at a time over
+ * chunks of GENERATE_CHUNK items: the draws of the classes,
+ * then the sizes, then the offsets, before the items are filled
+ * in from these columns. The loops over the columns keep to
+ * simple arithmetic the compiler can vectorize.
+ * 
+ * The items come out of the same distributions as those of
+ * _generate_work_item, though not out of the same draws. The
+ * alignment of the profile has to be a power of two, as the
+ * logical block size of a drive always is.
+ * 
+ * @param items         The items to fill in.
+ * @param count         Count of items.
+ * @param profile       The profile to generate a workload on.
+ * @param drive_size    The size of the share of the drive.
+ * @param gen           Generator of the calling thread.
+ */
+static void
+_generate_work_items(struct work_item **items, uint64_t count, struct work_profile *profile,
+                     uint64_t drive_size, struct work_generator *gen)
+{
+    uint64_t words[GENERATE_CHUNK], lengths[GENERATE_CHUNK], offsets[GENERATE_CHUNK];
+    uint32_t tasks[GENERATE_CHUNK], sequential[GENERATE_CHUNK], skewed[GENERATE_CHUNK];
+    uint32_t uniform[GENERATE_CHUNK], j;
+    uint64_t mask = profile->align - 1, reject, done, n, i, q, k, u;
+    uint8_t seq, skew;
+    struct work_class *c;
+    struct work_item *item;
+    unsigned __int128 m;
+
+    // Draws landing below this are rejected, as in rng_bounded.
+    reject = -drive_size % drive_size;
+
+    for (done = 0; done < count; done += n) {
+        n = (count - done < GENERATE_CHUNK)? count - done: GENERATE_CHUNK;
+
+        // Classes, each out of a single draw.
+        for (i = 0; i < n; i++) {
+            words[i] = rng_next(&gen->rng);
+        }
+        for (i = 0; i < n; i++) {
+            tasks[i] = work_alias_draw(words[i], profile->count, profile->threshold, profile->alias);
+        }
+
+        // Sizes, rounded up to the alignment.
+        for (i = 0; i < n; i++) {
+            lengths[i] = work_size_sample(&profile->classes[tasks[i]].size, &gen->rng);
+        }
+        for (i = 0; i < n; i++) {
+            lengths[i] = (lengths[i] + mask) & ~mask;
+        }
+
+        /*
+         * Offsets are drawn apart for each way of drawing them.
+         * The items of the chunk are split by the way their class
+         * draws offsets without branching on it, as the classes
+         * of a mix follow each other at random and a branch on
+         * them would mostly be mispredicted.
+         */
+        for (i = 0, q = 0, k = 0, u = 0; i < n; i++) {
+            c = &profile->classes[tasks[i]];
+            seq = (c->access == ACCESS_SEQUENTIAL);
+            skew = (c->offset.distribution != OFFSET_UNIFORM) & !seq;
+            sequential[q] = i;
+            skewed[k] = i;
+            uniform[u] = i;
+            q += seq;
+            k += skew;
+            u += !(seq | skew);
+        }
+        for (i = 0; i < q; i++) {
+            j = sequential[i];
+            offsets[j] = _sequential_offset(gen, &profile->classes[tasks[j]], tasks[j], &lengths[j],
+                                            drive_size);
+        }
+        for (i = 0; i < k; i++) {
+            j = skewed[i];
+            offsets[j] = offset_sampler_draw(&gen->offsets[tasks[j]], &gen->rng);
+        }
+        for (i = 0; i < u; i++) {
+            words[i] = rng_next(&gen->rng);
+        }
+        for (i = 0; i < u; i++) {
+            m = (unsigned __int128)words[i] * drive_size;
+            if ((uint64_t)m < reject) {
+                m = (unsigned __int128)rng_bounded(&gen->rng, drive_size) << 64;
+            }
+            offsets[uniform[i]] = (uint64_t)(m >> 64) & ~mask;
+        }
+
+        // Fill in the items, trimming them to the end of the drive.
+        for (i = 0; i < n; i++) {
+            item = items[done + i];
+            item->sequence = gen->sequence++;
+            item->task = tasks[i];
+            item->write = profile->classes[tasks[i]].write;
+            item->length = (drive_size - offsets[i] < lengths[i])? drive_size - offsets[i]: lengths[i];
+            item->offset = offsets[i] + gen->base;
+        }
+    }
+}
+
 #endif
\ No newline at end of file
@@ -0,0 +1,99 @@
+/**
+ * Source file for the time source behind nano_time.h. An
+ * invariant TSC is used when the CPU has one, as reading it
+ * costs a fraction of a clock_gettime call, otherwise the raw
+ * monotonic clock which NTP never slews.
+ *
+ * Author: Yash Gupta <yash_gupta12@live.com>
+ * Copyright: Yash Gupta
+ *
+ * License: MIT Public License
+ */
+#include "nano_time.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+// Time spent measuring the TSC frequency.
+#define CALIBRATE_NS        20000000ULL
+
+// Rounds of back to back time stamps to measure overhead on.
+#define OVERHEAD_ROUNDS     10000
+
+struct nano_time_source nano_time_source;
+
+/**
+ * Check whether the TSC ticks at a constant rate regardless
+ * of frequency scaling and sleep states.
+ *
+ * @return  1   The TSC is invariant.
+ * @return  0   The TSC is not invariant, or there is none.
+ */
+static int
+_tsc_invariant(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    unsigned int eax, ebx, ecx, edx;
+
+    if (!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx)) {
+        return 0;
+    }
+    return (edx >> 8) & 1;
+#else
+    return 0;
+#endif
+}
+
+/**
+ * Calibrate the TSC against NANO_TIME_CLOCK by counting ticks
+ * over a busy wait of CALIBRATE_NS.
+ */
+static void
+_tsc_calibrate(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    uint64_t tsc0, tsc1, ns0, ns1;
+
+    ns0 = _clockTime();
+    tsc0 = __rdtsc();
+    do {
+        ns1 = _clockTime();
+        tsc1 = __rdtsc();
+    } while (ns1 - ns0 < CALIBRATE_NS);
+
+    nano_time_source.mult = (uint64_t)(((unsigned __int128)(ns1 - ns0) << 32) / (tsc1 - tsc0));
+    nano_time_source.base_tsc = tsc1;
+    nano_time_source.base_ns = ns1;
+    nano_time_source.tsc = 1;
+#endif
+}
+
+/**
+ * Pick and calibrate the time source and measure its overhead.
+ * The overhead is the smallest gap ever seen between two back
+ * to back time stamps, which is what timing an empty region
+ * costs. It is subtracted from measured service times so that
+ * very short I/Os are not inflated by the clock.
+ *
+ * NOTE: This must be called before any other thread takes a
+ * time stamp.
+ */
+void
+nano_time_init(void)
+{
+    uint64_t t0, t1, i;
+
+    nano_time_source.tsc = 0;
+    if (_tsc_invariant()) {
+        _tsc_calibrate();
+    }
+
+    nano_time_source.overhead = UINT64_MAX;
+    for (i = 0; i < OVERHEAD_ROUNDS; i++) {
+        t0 = _nowTime();
+        t1 = _nowTime();
+        if (t1 - t0 < nano_time_source.overhead) {
+            nano_time_source.overhead = t1 - t0;
+        }
+    }
+}
@@ -1,19 +1,84 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#ifndef _NANO_TIME_H_
+#define _NANO_TIME_H_
+
+// Clock time stamps are taken on when the TSC cannot be used.
+// It must never jump, as time stamps are compared against
+// deadlines and across threads.
+#define NANO_TIME_CLOCK CLOCK_MONOTONIC_RAW
 
 #define INIT_TIME(x)    _initTime(x)
 #define GET_TIME(x)     _getTime(x)
 
+/*
+ * State of the time source, filled in once by nano_time_init.
+ * With an invariant TSC, ticks are converted to nanoseconds as
+ * base_ns + ((tsc - base_tsc) * mult) >> 32, which stays on the
+ * same time line as NANO_TIME_CLOCK.
+ */
+struct nano_time_source {
+    uint8_t tsc;
+    uint64_t mult;
+    uint64_t base_tsc;
+    uint64_t base_ns;
+
+    // Smallest time taken by a pair of time stamps.
+    uint64_t overhead;
+};
+
+extern struct nano_time_source nano_time_source;
+
+/**
+ * Pick and calibrate the time source and measure its overhead.
+ */
+void
+nano_time_init(void);
+
+/**
+ * Read the clock the TSC is calibrated against
+ * @return Time in nano seconds
+ */
+static inline uint64_t
+_clockTime(void)
+{
+    struct timespec now;
+
+    clock_gettime(NANO_TIME_CLOCK, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+/**
+ * Acquire the current time from the fastest time source
+ * available
+ * @return Time in nano seconds
+ */
+static inline uint64_t
+_nowTime(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    if (nano_time_source.tsc) {
+        return nano_time_source.base_ns + (uint64_t)(((unsigned __int128)(__rdtsc() -
+               nano_time_source.base_tsc) * nano_time_source.mult) >> 32);
+    }
+#endif
+    return _clockTime();
+}
+
 /**
  * Initialize a variable to hold the timestamp
  * accurate upto nanoseconds
  * @param start Address of variable which will hold the timestamp
  */
 static inline void
-_initTime(struct timespec *start)
+_initTime(uint64_t *start)
 {
-    clock_gettime(CLOCK_REALTIME, start);
+    *start = _nowTime();
 }
 
 /**
@@ -21,17 +86,13 @@ _initTime(struct timespec *start)
  * passed between time of call and the time stamp
  * in variable
  * @param start The variablewhich holds previous time stamp
- * @return Difference in Nano Seconds
+ * @return Difference in Nano Seconds (negative if start
+ *         lies in the future)
  */
-static inline double
-_getTime(struct timespec start)
+static inline int64_t
+_getTime(uint64_t start)
 {
-    double time_passed;
-    struct timespec now;
-
-    clock_gettime(CLOCK_REALTIME, &now);
-    time_passed = (int64_t)1000000000L * (int64_t)(now.tv_sec - start.tv_sec);
-    time_passed += (int64_t)(now.tv_nsec - start.tv_nsec);
-
-    return time_passed / 1000000000.0;
+    return (int64_t)(_nowTime() - start);
 }
+
+#endif
@@ -0,0 +1,129 @@
+/**
+ * Source file for an open loop arrival pacer in C. Arrivals
+ * are scheduled on absolute deadlines, so neither oversleeping
+ * nor the time taken to issue an arrival drifts the schedule.
+ *
+ * Author: Yash Gupta <yash_gupta12@live.com>
+ * Copyright: Yash Gupta
+ *
+ * License: MIT Public License
+ */
+#include "pacer.h"
+#include <unistd.h>
+#include <errno.h>
+
+// Waits shorter than this are spun off, as the scheduler
+// cannot be trusted to wake a sleeper up any more precisely.
+#define PACER_SPIN_NS       50000
+
+// Arrivals closer together than this are issued together.
+// Without spinning, that is every arrival within a sleep.
+#define PACER_SLACK_NS      2000
+#define PACER_SLACK_SLEEP_NS    PACER_SPIN_NS
+
+/**
+ * Start a pacer with its first deadline set to its start.
+ * Spinning is only worth it with a spare CPU, on a single CPU
+ * it would take time away from the threads issuing the I/O.
+ * The same goes for a caller which shares its CPU with those
+ * threads, which has to forbid spinning.
+ *
+ * @param   p       The pacer to start.
+ * @param   start   Time stamp to start at, 0 for now.
+ * @param   spin    Spinning is allowed.
+ */
+void
+pacer_init(pacer *p, uint64_t start, uint8_t spin)
+{
+    if (start) {
+        p->start = start;
+    } else {
+        INIT_TIME(&p->start);
+    }
+    p->deadline = p->start;
+    p->spin = spin && (sysconf(_SC_NPROCESSORS_ONLN) > 1);
+    p->slack_ns = (p->spin)? PACER_SLACK_NS: PACER_SLACK_SLEEP_NS;
+}
+
+/**
+ * Move the deadline of the pacer forward by gap seconds.
+ * The deadline moves relative to the previous deadline and
+ * not to the current time.
+ *
+ * @param   p       The pacer to advance.
+ * @param   gap     Seconds until the next deadline.
+ */
+void
+pacer_advance(pacer *p, double gap)
+{
+    p->deadline += (uint64_t)(gap * 1000000000.0 + 0.5);
+}
+
+/**
+ * Set the deadline of the pacer to a fixed offset from the
+ * time it was started.
+ *
+ * @param   p       The pacer to schedule.
+ * @param   offset  Nanoseconds from the start of the pacer.
+ */
+void
+pacer_schedule(pacer *p, uint64_t offset)
+{
+    p->deadline = p->start + offset;
+}
+
+/**
+ * Wait until the deadline of the pacer is reached. The bulk
+ * of the wait is slept with an absolute timeout, after which
+ * the last PACER_SPIN_NS are spun off if spinning is enabled.
+ *
+ * Deadlines live on the time line of nano_time.h, which need
+ * not be the clock the scheduler sleeps on, so the remaining
+ * wait is carried over to CLOCK_MONOTONIC first. Any error in
+ * doing so only affects this one wait, never the schedule.
+ *
+ * @param   p       The pacer to wait on.
+ *
+ * @return  late    Seconds by which the deadline had already
+ *                  passed when called, 0 if it had not.
+ */
+double
+pacer_wait(pacer *p)
+{
+    struct timespec wake;
+    int64_t remaining;
+
+    remaining = -GET_TIME(p->deadline);
+    if (remaining <= 0) {
+        return -remaining / 1000000000.0;
+    }
+
+    if (p->spin) {
+        remaining -= PACER_SPIN_NS;
+    }
+    if (remaining > 0) {
+        clock_gettime(CLOCK_MONOTONIC, &wake);
+        remaining += wake.tv_nsec;
+        wake.tv_sec += remaining / 1000000000L;
+        wake.tv_nsec = remaining % 1000000000L;
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wake, NULL) == EINTR);
+    }
+
+    while (p->spin && GET_TIME(p->deadline) < 0);
+
+    return 0;
+}
+
+/**
+ * Acquire the number of seconds elapsed since the pacer
+ * was started.
+ *
+ * @param   p   The pacer to query.
+ *
+ * @return  The elapsed time in seconds.
+ */
+double
+pacer_elapsed(pacer *p)
+{
+    return GET_TIME(p->start) / 1000000000.0;
+}
@@ -0,0 +1,59 @@
+/**
+ * Header file for an open loop arrival pacer in C. Arrivals
+ * are scheduled on absolute deadlines, so neither oversleeping
+ * nor the time taken to issue an arrival drifts the schedule.
+ *
+ * Author: Yash Gupta <yash_gupta12@live.com>
+ * Copyright: Yash Gupta
+ *
+ * License: MIT Public License
+ */
+#include "../nano_time.h"
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+
+#ifndef _PACER_H_
+#define _PACER_H_
+
+typedef struct pacer {
+    uint64_t start;
+    uint64_t deadline;
+    uint64_t slack_ns;
+    uint8_t spin;
+} pacer;
+
+/**
+ * Start a pacer with its first deadline set to its start,
+ * which is either the given time stamp or now.
+ */
+void
+pacer_init(pacer *p, uint64_t start, uint8_t spin);
+
+/**
+ * Move the deadline of the pacer forward by gap seconds.
+ */
+void
+pacer_advance(pacer *p, double gap);
+
+/**
+ * Set the deadline of the pacer to a fixed offset from the
+ * time it was started.
+ */
+void
+pacer_schedule(pacer *p, uint64_t offset);
+
+/**
+ * Wait until the deadline of the pacer is reached.
+ */
+double
+pacer_wait(pacer *p);
+
+/**
+ * Acquire the number of seconds elapsed since the pacer
+ * was started.
+ */
+double
+pacer_elapsed(pacer *p);
+
+#endif
@@ -0,0 +1,69 @@
+/**
+ * Source file for a fast, seedable 64 bit pseudo random number
+ * generator (xoshiro256**) in C. Each thread keeps its own
+ * generator, so drawing a number never touches shared state.
+ *
+ * Author: Yash Gupta <yash_gupta12@live.com>
+ * Copyright: Yash Gupta
+ *
+ * License: MIT Public License
+ */
+#include "rng.h"
+
+/**
+ * Seed a generator from a single 64 bit seed. The state is
+ * filled from a splitmix64 sequence started at the seed, which
+ * never yields the all zero state xoshiro cannot leave.
+ *
+ * @param   r       The generator to seed.
+ * @param   seed    The seed.
+ */
+void
+rng_seed(rng *r, uint64_t seed)
+{
+    uint64_t z;
+    int i;
+
+    for (i = 0; i < 4; i++) {
+        seed += 0x9e3779b97f4a7c15ULL;
+        z = seed;
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        r->s[i] = z ^ (z >> 31);
+    }
+}
+
+/**
+ * Advance a generator by 2^128 draws. Threads sharing a seed
+ * each jump a different number of times to get streams which
+ * are reproducible and never overlap.
+ *
+ * @param   r   The generator to advance.
+ */
+void
+rng_jump(rng *r)
+{
+    static const uint64_t jump[] = {
+        0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL,
+        0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL
+    };
+    uint64_t s[4] = {0, 0, 0, 0};
+    int i, b;
+
+    for (i = 0; i < 4; i++) {
+        for (b = 0; b < 64; b++) {
+            if (jump[i] & (1ULL << b)) {
+                s[0] ^= r->s[0];
+                s[1] ^= r->s[1];
+                s[2] ^= r->s[2];
+                s[3] ^= r->s[3];
+            }
+            rng_next(r);
+        }
+    }
+
+    r->s[0] = s[0];
+    r->s[1] = s[1];
+    r->s[2] = s[2];
+    r->s[3] = s[3];
+}
@@ -0,0 +1,103 @@
+/**
+ * Header file for a fast, seedable 64 bit pseudo random number
+ * generator (xoshiro256**) in C. Each thread keeps its own
+ * generator, so drawing a number never touches shared state.
+ *
+ * Author: Yash Gupta <yash_gupta12@live.com>
+ * Copyright: Yash Gupta
+ *
+ * License: MIT Public License
+ *
+ * Note: The generator and the seeding with splitmix64 were
+ * obtained from the reference implementations by David
+ * Blackman and Sebastiano Vigna. Bounded sampling uses the
+ * multiply and reject method by Daniel Lemire.
+ */
+#include <stdlib.h>
+#include <stdint.h>
+
+#ifndef _RNG_H_
+#define _RNG_H_
+
+typedef struct rng {
+    uint64_t s[4];
+} rng;
+
+/**
+ * Seed a generator from a single 64 bit seed.
+ */
+void
+rng_seed(rng *r, uint64_t seed);
+
+/**
+ * Advance a generator by 2^128 draws, so that generators
+ * seeded alike and jumped a different number of times never
+ * overlap.
+ */
+void
+rng_jump(rng *r);
+
+static inline uint64_t
+_rng_rotl(uint64_t x, int k)
+{
+    return (x << k) | (x >> (64 - k));
+}
+
+/**
+ * Draw a uniformly distributed 64 bit number.
+ */
+static inline uint64_t
+rng_next(rng *r)
+{
+    uint64_t result, t;
+
+    result = _rng_rotl(r->s[1] * 5, 7) * 9;
+    t = r->s[1] << 17;
+
+    r->s[2] ^= r->s[0];
+    r->s[3] ^= r->s[1];
+    r->s[1] ^= r->s[2];
+    r->s[0] ^= r->s[3];
+    r->s[2] ^= t;
+    r->s[3] = _rng_rotl(r->s[3], 45);
+
+    return result;
+}
+
+/**
+ * Draw a uniformly distributed number in [0, range) without
+ * modulo bias. Only a draw landing in the short leftover of
+ * the 64 bit space is rejected, which for any range below
+ * 2^63 happens less than half the time, and almost never for
+ * small ranges.
+ */
+static inline uint64_t
+rng_bounded(rng *r, uint64_t range)
+{
+    unsigned __int128 m;
+    uint64_t low, threshold;
+
+    m = (unsigned __int128)rng_next(r) * range;
+    low = (uint64_t)m;
+    if (low < range) {
+        threshold = -range % range;
+        while (low < threshold) {
+            m = (unsigned __int128)rng_next(r) * range;
+            low = (uint64_t)m;
+        }
+    }
+
+    return m >> 64;
+}
+
+/**
+ * Draw a uniformly distributed double in (0, 1]. Zero is
+ * left out so that the result can safely be passed to log.
+ */
+static inline double
+rng_uniform(rng *r)
+{
+    return ((rng_next(r) >> 11) + 1) * (1.0 / 9007199254740992.0);
+}
+
+#endif
@@ -0,0 +1,191 @@
+/**
+ * Source file for workload scripts. A script runs a drive
+ * through an ordered list of phases, each with a work profile,
+ * an arrival process and a duration of its own, back to back
+ * within a single run.
+ *
+ * Author: Yash Gupta <yash_gupta12@live.com>
+ * Copyright: Yash Gupta
+ *
+ * License: MIT Public License
+ */
+#define _GNU_SOURCE
+#include "script.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Start a phase out of its line, which holds "phase", its name
+ * and the keys below.
+ *
+ *  duration=SECONDS                (required)
+ *  rate=R                          Poisson arrivals per second.
+ *  arrival=PROCESS                 Any process, see arrival_parse.
+ *
+ * Exactly one of rate and arrival is required.
+ *
+ * @param   ph      The phase to start.
+ * @param   save    State of strtok_r over the line.
+ *
+ * @return  0       Successfully started.
+ * @return  -1      The line is malformed.
+ */
+static int
+_script_phase(struct phase *ph, char **save)
+{
+    char *name, *key, *value, *end;
+    uint8_t arrivals = 0;
+    double rate;
+
+    memset(ph, 0, sizeof *ph);
+    work_profile_init(&ph->profile);
+
+    name = strtok_r(NULL, " \t\r\n", save);
+    if (!name || strchr(name, '=')) {
+        return -1;
+    }
+    snprintf(ph->name, sizeof ph->name, "%s", name);
+
+    while ((key = strtok_r(NULL, " \t\r\n", save)) != NULL) {
+        value = strchr(key, '=');
+        if (!value || arrivals > 1) {
+            return -1;
+        }
+        *value++ = '\0';
+
+        if (!strcmp(key, "duration")) {
+            ph->duration = strtol(value, &end, 0);
+            if (*end || ph->duration <= 0) {
+                return -1;
+            }
+        } else if (!strcmp(key, "rate")) {
+            rate = strtod(value, &end);
+            if (*end || !(rate > 0)) {
+                return -1;
+            }
+            arrival_poisson(&ph->arrival, rate);
+            arrivals++;
+        } else if (!strcmp(key, "arrival")) {
+            if (arrival_parse(&ph->arrival, value)) {
+                return -1;
+            }
+            arrivals++;
+        } else {
+            return -1;
+        }
+    }
+
+    return (ph->duration && arrivals == 1)? 0: -1;
+}
+
+/**
+ * Load the phases of a script. A line which starts with
+ * "phase" starts a phase, see _script_phase, and every line
+ * after it up to the next phase describes a class of the work
+ * profile of the phase, see work_profile_parse. Anything after a
+ * '#' is a comment. A sequential class named as one of an earlier
+ * phase, with as many streams, resumes where that one left off.
+ *
+ * Eg:
+ *  phase fill duration=60 rate=500
+ *  fill op=write access=sequential size=1048576
+ *  phase mixed duration=120 arrival=mmpp:5000@5,40000@0.5
+ *  get op=read weight=70 offset=zipf:0.99
+ *  put op=write weight=30
+ *
+ * @param   path    Path of the script.
+ * @param   phases  MAX_PHASES phases to fill in.
+ * @param   count   Count of phases loaded.
+ *
+ * @return  0       Successfully loaded every phase.
+ * @return  line    Number of the first malformed line.
+ * @return  -1      The file could not be opened.
+ */
+int
+script_load(const char *path, struct phase *phases, uint32_t *count)
+{
+    char *line = NULL, *copy, *word, *save;
+    struct phase *ph = NULL;
+    size_t cap = 0;
+    FILE *f;
+    int n, ret;
+
+    f = fopen(path, "r");
+    if (!f) {
+        return -1;
+    }
+
+    *count = 0;
+    ret = 0;
+    for (n = 1; !ret && getline(&line, &cap, f) != -1; n++) {
+        copy = strdup(line);
+        if (!copy) {
+            ret = n;
+            break;
+        }
+
+        if ((word = strchr(copy, '#')) != NULL) {
+            *word = '\0';
+        }
+        word = strtok_r(copy, " \t\r\n", &save);
+        if (word && !strcmp(word, "phase")) {
+            // The profile of the phase before is complete.
+            if ((ph && work_profile_finish(&ph->profile)) || *count == MAX_PHASES) {
+                ret = n;
+            } else {
+                ph = &phases[(*count)++];
+                ret = (_script_phase(ph, &save))? n: 0;
+            }
+        } else if (word) {
+            ret = (!ph || work_profile_parse(&ph->profile, line))? n: 0;
+        }
+        free(copy);
+    }
+
+    if (!ret && (!ph || work_profile_finish(&ph->profile))) {
+        ret = n;
+    }
+
+    free(line);
+    fclose(f);
+
+    return ret;
+}
+
+/**
+ * Acquire the total duration of a list of phases.
+ *
+ * @param   phases  The phases.
+ * @param   count   Count of phases.
+ *
+ * @return  Seconds the phases last together.
+ */
+long int
+script_duration(struct phase *phases, uint32_t count)
+{
+    long int duration = 0;
+    uint32_t i;
+
+    for (i = 0; i < count; i++) {
+        duration += phases[i].duration;
+    }
+
+    return duration;
+}
+
+/**
+ * Deallocate the arrival processes of a list of phases.
+ *
+ * @param   phases  The phases.
+ * @param   count   Count of phases.
+ */
+void
+script_free(struct phase *phases, uint32_t count)
+{
+    uint32_t i;
+
+    for (i = 0; i < count; i++) {
+        arrival_free(&phases[i].arrival);
+    }
+}
@@ -0,0 +1,51 @@
+/**
+ * Header file for workload scripts. A script runs a drive
+ * through an ordered list of phases, each with a work profile,
+ * an arrival process and a duration of its own, back to back
+ * within a single run.
+ *
+ * Author: Yash Gupta <yash_gupta12@live.com>
+ * Copyright: Yash Gupta
+ *
+ * License: MIT Public License
+ */
+#include "../work_profile.h"
+#include "../arrival/arrival.h"
+#include <stdint.h>
+
+#ifndef _SCRIPT_H_
+#define _SCRIPT_H_
+
+// Largest number of phases of a script.
+#define MAX_PHASES          32
+
+// Length of the name of a phase, terminator included.
+#define PHASE_NAME_LEN      32
+
+// Phase of a run.
+struct phase {
+    char name[PHASE_NAME_LEN];
+    long int duration;
+    arrival arrival;
+    struct work_profile profile;
+};
+
+/**
+ * Load the phases of a script.
+ */
+int
+script_load(const char *path, struct phase *phases, uint32_t *count);
+
+/**
+ * Acquire the total duration of a list of phases.
+ */
+long int
+script_duration(struct phase *phases, uint32_t count);
+
+/**
+ * Deallocate the arrival processes of a list of phases.
+ */
+void
+script_free(struct phase *phases, uint32_t count);
+
+#endif
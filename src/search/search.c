@@ -0,0 +1,145 @@
+/**
+ * Source file for the saturation search of a drive, which looks
+ * for the highest arrival rate the drive sustains while a tail
+ * latency stays within a target. Rates are either stepped up
+ * until the target is missed, or bisected between two bounds.
+ *
+ * Author: Yash Gupta <yash_gupta12@live.com>
+ * Copyright: Yash Gupta
+ *
+ * License: MIT Public License
+ */
+#include "search.h"
+#include <stdio.h>
+#include <string.h>
+
+/**
+ * Parse a search and the target it searches for, one of:
+ *
+ *  step:START:STEP[:STEPS]         START, START + STEP, ... for
+ *                                  at most STEPS rates.
+ *  binary:LOW:HIGH[:ROUNDS]        LOW and HIGH, then ROUNDS
+ *                                  rounds of bisection.
+ *
+ * Rates are in arrivals per second. The target is a percentile
+ * of the response time and its limit in microseconds.
+ *
+ * Eg: "binary:1000:200000" and "99.9:500" for the highest rate
+ * up to 200000/s with a p99.9 within 500us.
+ *
+ * @param   s       The search to fill in.
+ * @param   spec    The search to parse.
+ * @param   slo     The target to parse.
+ *
+ * @return  0       Successfully parsed.
+ * @return  -1      Either is malformed.
+ */
+int
+search_parse(search *s, const char *spec, const char *slo)
+{
+    char *end;
+
+    memset(s, 0, sizeof *s);
+    if (!strncmp(spec, "step:", 5)) {
+        s->mode = SEARCH_STEP;
+        s->steps = SEARCH_MAX_STEPS;
+        end = (char*)spec + 4;
+    } else if (!strncmp(spec, "binary:", 7)) {
+        s->mode = SEARCH_BINARY;
+        s->steps = SEARCH_ROUNDS;
+        end = (char*)spec + 6;
+    } else {
+        return -1;
+    }
+
+    s->low = strtod(end + 1, &end);
+    if (*end != ':') {
+        return -1;
+    }
+    s->step = strtod(end + 1, &end);
+    if (*end == ':') {
+        s->steps = strtoul(end + 1, &end, 0);
+    }
+    if (*end || !(s->low > 0) || !(s->step > 0)) {
+        return -1;
+    }
+
+    // The second number of a binary search is its upper bound.
+    if (s->mode == SEARCH_BINARY) {
+        s->high = s->step;
+        if (!(s->high > s->low)) {
+            return -1;
+        }
+    } else if (s->steps == 0 || s->steps > SEARCH_MAX_STEPS) {
+        return -1;
+    }
+
+    s->percentile = strtod(slo, &end);
+    if (*end != ':') {
+        return -1;
+    }
+    s->limit = strtod(end + 1, &end) * 1000.0;
+
+    return (*end || !(s->percentile > 0) || !(s->percentile <= 100) || !(s->limit > 0))? -1: 0;
+}
+
+/**
+ * Acquire the next rate to try, which has to be reported on
+ * before the one after it is asked for.
+ *
+ * @param   s       The search.
+ * @param   rate    The rate to try.
+ *
+ * @return  0       There is a rate to try.
+ * @return  -1      The search is over.
+ */
+int
+search_next(search *s, double *rate)
+{
+    if (s->done) {
+        return -1;
+    }
+
+    if (s->mode == SEARCH_STEP) {
+        s->rate = s->low + s->tried * s->step;
+    } else if (s->tried < 2) {
+        s->rate = (s->tried)? s->high: s->low;
+    } else {
+        s->rate = (s->low + s->high) / 2;
+    }
+
+    s->tried++;
+    *rate = s->rate;
+
+    return 0;
+}
+
+/**
+ * Report whether the rate last tried met the target, which
+ * decides the rates tried next.
+ *
+ * @param   s       The search.
+ * @param   met     The rate met the target.
+ */
+void
+search_report(search *s, uint8_t met)
+{
+    if (met && s->rate > s->best) {
+        s->best = s->rate;
+    }
+
+    if (s->mode == SEARCH_STEP) {
+        s->done = !met || s->tried == s->steps;
+    } else if (s->tried == 1) {
+        s->done = !met;
+    } else if (s->tried == 2) {
+        s->done = met;
+    } else {
+        if (met) {
+            s->low = s->rate;
+        } else {
+            s->high = s->rate;
+        }
+        s->done = s->tried == s->steps + 2;
+    }
+}
@@ -0,0 +1,78 @@
+/**
+ * Header file for the saturation search of a drive, which looks
+ * for the highest arrival rate the drive sustains while a tail
+ * latency stays within a target. Rates are either stepped up
+ * until the target is missed, or bisected between two bounds.
+ *
+ * Author: Yash Gupta <yash_gupta12@live.com>
+ * Copyright: Yash Gupta
+ *
+ * License: MIT Public License
+ */
+#include <stdlib.h>
+#include <stdint.h>
+
+#ifndef _SEARCH_H_
+#define _SEARCH_H_
+
+// Largest number of rates a step search tries.
+#define SEARCH_MAX_STEPS    64
+
+// Rounds of bisection of a binary search, unless given.
+#define SEARCH_ROUNDS       8
+
+// Search Modes
+enum search_mode {
+    SEARCH_STEP = 0,
+    SEARCH_BINARY
+};
+
+typedef struct search {
+    /*
+     * A step search tries low, low + step, ... up to steps
+     * rates and stops at the first one which misses the target.
+     * A binary search tries low and high first, and stops right
+     * there if low misses the target or high meets it. Otherwise
+     * it bisects the rates in between for steps rounds, keeping
+     * low on a rate which met the target and high on one which
+     * did not.
+     */
+    uint8_t mode;
+    double low;
+    double high;
+    double step;
+    uint32_t steps;
+
+    // The target: the percentile of the response time, which
+    // must not exceed limit nanoseconds.
+    double percentile;
+    double limit;
+
+    // Rates tried so far, the last of them and the highest one
+    // which met the target, 0 for none.
+    uint32_t tried;
+    double rate;
+    double best;
+    uint8_t done;
+} search;
+
+/**
+ * Parse a search such as "step:START:STEP[:STEPS]" or
+ * "binary:LOW:HIGH[:ROUNDS]" and its target "PERCENTILE:US".
+ */
+int
+search_parse(search *s, const char *spec, const char *slo);
+
+/**
+ * Acquire the next rate to try.
+ */
+int
+search_next(search *s, double *rate);
+
+/**
+ * Report whether the rate last tried met the target.
+ */
+void
+search_report(search *s, uint8_t met);
+
+#endif
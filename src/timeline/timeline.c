@@ -0,0 +1,366 @@
+/**
+ * Source file for a timeline of latencies in C, which keeps a
+ * coarse log-linear latency histogram for every second of a run
+ * so that the effect of bursts on the drive can be followed over
+ * time. A timeline is shared by the threads of a drive, each of
+ * which records through a recorder of its own holding only the
+ * last few seconds, so that the memory it takes grows with the
+ * duration of the run but not with the count of threads.
+ *
+ * Author: Yash Gupta <yash_gupta12@live.com>
+ * Copyright: Yash Gupta
+ *
+ * License: MIT Public License
+ */
+#include "timeline.h"
+#include <stdio.h>
+#include <string.h>
+
+#define HALF_SUB_BUCKETS    (TIMELINE_SUB_BUCKETS / 2)
+
+/**
+ * Map a value to the index of its bucket, the same way
+ * histograms do with fewer bits.
+ *
+ * @param   value   The value to map.
+ *
+ * @return  index   Index of the bucket holding value.
+ */
+static uint32_t
+_timeline_index(uint64_t value)
+{
+    uint32_t shift;
+
+    if (value < TIMELINE_SUB_BUCKETS) {
+        return value;
+    }
+
+    shift = 64 - __builtin_clzll(value) - TIMELINE_SUB_BITS;
+    if (shift > TIMELINE_MAX_BITS - TIMELINE_SUB_BITS) {
+        return TIMELINE_BUCKETS - 1;
+    }
+
+    return (shift + 1) * HALF_SUB_BUCKETS + (value >> shift) - HALF_SUB_BUCKETS;
+}
+
+/**
+ * Map a bucket index back to the largest value it holds.
+ *
+ * @param   index   Index of the bucket.
+ *
+ * @return  value   Largest value mapped to index.
+ */
+static uint64_t
+_timeline_value(uint32_t index)
+{
+    uint32_t shift;
+    uint64_t sub;
+
+    if (index < TIMELINE_SUB_BUCKETS) {
+        return index;
+    }
+
+    shift = index / HALF_SUB_BUCKETS - 1;
+    sub = index % HALF_SUB_BUCKETS + HALF_SUB_BUCKETS;
+
+    return ((sub + 1) << shift) - 1;
+}
+
+/**
+ * Acquire the second of a timeline a time stamp falls in. Time
+ * stamps before the start fall in the first second and those
+ * after the end in the last.
+ *
+ * @param   t       The timeline.
+ * @param   when    Time stamp in nanoseconds.
+ *
+ * @return  second  Index of the second.
+ */
+static uint64_t
+_timeline_second(timeline *t, uint64_t when)
+{
+    uint64_t second;
+
+    second = (when > t->start)? (when - t->start) / 1000000000ULL: 0;
+    return (second < t->seconds)? second: t->seconds - 1;
+}
+
+/**
+ * Account for a request in a second.
+ *
+ * @param   s       The second.
+ * @param   bytes   Length of the request.
+ * @param   latency Latency of the request in nanoseconds.
+ */
+static void
+_timeline_second_record(struct timeline_second *s, uint64_t bytes, uint64_t latency)
+{
+    s->count++;
+    s->bytes += bytes;
+    s->total += latency;
+    s->max = (latency > s->max)? latency: s->max;
+    s->buckets[_timeline_index(latency)]++;
+}
+
+/**
+ * Add every request accounted in a second to another.
+ *
+ * @param   d       Second to add to.
+ * @param   s       Second to add.
+ */
+static void
+_timeline_second_merge(struct timeline_second *d, struct timeline_second *s)
+{
+    uint32_t b;
+
+    d->count += s->count;
+    d->bytes += s->bytes;
+    d->total += s->total;
+    d->max = (s->max > d->max)? s->max: d->max;
+    for (b = 0; b < TIMELINE_BUCKETS; b++) {
+        d->buckets[b] += s->buckets[b];
+    }
+}
+
+/**
+ * Acquire the value below which the specified percentage of
+ * the requests of a second fall, never above the largest.
+ *
+ * @param   s           The second.
+ * @param   percentile  Percentage in [0, 100].
+ *
+ * @return  value       The percentile, 0 for an empty second.
+ */
+static uint64_t
+_timeline_percentile(struct timeline_second *s, double percentile)
+{
+    uint64_t rank, seen = 0, value;
+    uint32_t i;
+
+    if (!s->count) {
+        return 0;
+    }
+
+    rank = (percentile / 100.0) * s->count + 0.5;
+    rank = (rank < 1)? 1: rank;
+    for (i = 0; i < TIMELINE_BUCKETS; i++) {
+        seen += s->buckets[i];
+        if (seen >= rank) {
+            break;
+        }
+    }
+
+    value = _timeline_value(i);
+    return (value > s->max)? s->max: value;
+}
+
+/**
+ * Create a timeline of a number of seconds from a time stamp
+ * on. Requests completed after the last second are accounted to
+ * it, as are those completed before the start to the first.
+ *
+ * @param   start   Time stamp of the start of the first second.
+ * @param   seconds Count of seconds.
+ *
+ * @return  A timeline.
+ * @return  NULL    Malloc error.
+ */
+timeline*
+timeline_create(uint64_t start, uint64_t seconds)
+{
+    timeline *t;
+
+    t = malloc(sizeof *t);
+    if (!t) {
+        return NULL;
+    }
+
+    t->start = start;
+    t->seconds = (seconds)? seconds: 1;
+    t->slots = calloc(t->seconds, sizeof(*t->slots));
+    if (!t->slots) {
+        free(t);
+        return NULL;
+    }
+    pthread_mutex_init(&t->lock, NULL);
+
+    return t;
+}
+
+/**
+ * Deallocate a timeline.
+ *
+ * @param   t   The timeline to deallocate.
+ */
+void
+timeline_free(timeline *t)
+{
+    pthread_mutex_destroy(&t->lock);
+    free(t->slots);
+    free(t);
+}
+
+/**
+ * Record a request completed at a time stamp in a timeline.
+ *
+ * @param   t       The timeline.
+ * @param   when    Time stamp of the completion in nanoseconds.
+ * @param   bytes   Length of the request.
+ * @param   latency Latency of the request in nanoseconds.
+ */
+void
+timeline_record(timeline *t, uint64_t when, uint64_t bytes, uint64_t latency)
+{
+    _timeline_second_record(&t->slots[_timeline_second(t, when)], bytes, latency);
+}
+
+/**
+ * Add every request recorded in src to dst. Both need to span
+ * the same seconds.
+ *
+ * @param   dst     Timeline to add to.
+ * @param   src     Timeline to add.
+ */
+void
+timeline_merge(timeline *dst, timeline *src)
+{
+    uint64_t i;
+
+    for (i = 0; i < dst->seconds && i < src->seconds; i++) {
+        if (src->slots[i].count) {
+            _timeline_second_merge(&dst->slots[i], &src->slots[i]);
+        }
+    }
+}
+
+/**
+ * Create a recorder of the requests of a thread into a timeline,
+ * holding no seconds yet.
+ *
+ * @param   t       The timeline to record into.
+ *
+ * @return  A recorder.
+ * @return  NULL    Malloc error.
+ */
+timeline_recorder*
+timeline_recorder_create(timeline *t)
+{
+    timeline_recorder *r;
+
+    r = calloc(1, sizeof *r);
+    if (!r) {
+        return NULL;
+    }
+    r->t = t;
+
+    return r;
+}
+
+/**
+ * Merge a second held by a recorder into its timeline and clear
+ * it for another second.
+ *
+ * @param   r       The recorder.
+ * @param   i       Index of the second among those held.
+ */
+static void
+_timeline_recorder_flush(timeline_recorder *r, uint32_t i)
+{
+    pthread_mutex_lock(&r->t->lock);
+    _timeline_second_merge(&r->t->slots[r->held[i]], &r->slots[i]);
+    pthread_mutex_unlock(&r->t->lock);
+
+    memset(&r->slots[i], 0, sizeof(r->slots[i]));
+}
+
+/**
+ * Record a request completed at a time stamp through a recorder.
+ * Seconds are held in the slot of their index modulo
+ * TIMELINE_RECENT, and a second pushes the one held before it
+ * out into the timeline. A request completing in a second so
+ * old that a later one already took its place, which only a
+ * latency of several seconds leads to, goes straight to the
+ * timeline.
+ *
+ * @param   r       The recorder.
+ * @param   when    Time stamp of the completion in nanoseconds.
+ * @param   bytes   Length of the request.
+ * @param   latency Latency of the request in nanoseconds.
+ */
+void
+timeline_recorder_record(timeline_recorder *r, uint64_t when, uint64_t bytes, uint64_t latency)
+{
+    uint64_t second;
+    uint32_t i;
+
+    second = _timeline_second(r->t, when);
+    i = second % TIMELINE_RECENT;
+    if (r->slots[i].count && r->held[i] > second) {
+        pthread_mutex_lock(&r->t->lock);
+        _timeline_second_record(&r->t->slots[second], bytes, latency);
+        pthread_mutex_unlock(&r->t->lock);
+        return;
+    }
+
+    if (r->slots[i].count && r->held[i] < second) {
+        _timeline_recorder_flush(r, i);
+    }
+    r->held[i] = second;
+    _timeline_second_record(&r->slots[i], bytes, latency);
+}
+
+/**
+ * Merge every second a recorder still holds into its timeline
+ * and deallocate the recorder.
+ *
+ * @param   r       The recorder.
+ */
+void
+timeline_recorder_free(timeline_recorder *r)
+{
+    uint32_t i;
+
+    for (i = 0; i < TIMELINE_RECENT; i++) {
+        if (r->slots[i].count) {
+            _timeline_recorder_flush(r, i);
+        }
+    }
+    free(r);
+}
+
+/**
+ * Write a timeline out as CSV, a second per line up to the
+ * last second which saw any requests. Latencies are in
+ * microseconds and throughput in MiB per second.
+ *
+ * @param   t       The timeline.
+ * @param   path    Path of the CSV file.
+ *
+ * @return  0       Successfully written.
+ * @return  -1      The file could not be written.
+ */
+int
+timeline_write(timeline *t, const char *path)
+{
+    struct timeline_second *s;
+    uint64_t last, i;
+    FILE *f;
+
+    f = fopen(path, "w");
+    if (!f) {
+        return -1;
+    }
+
+    for (last = t->seconds; last > 0 && !t->slots[last - 1].count; last--);
+
+    fprintf(f, "second,operations,mib_per_s,mean_us,p50_us,p99_us,p99.9_us,max_us\n");
+    for (i = 0; i < last; i++) {
+        s = &t->slots[i];
+        fprintf(f, "%lu,%lu,%.2lf,%.1lf,%.1lf,%.1lf,%.1lf,%.1lf\n", i, s->count, s->bytes / 1048576.0,
+                (s->count)? s->total / 1000.0 / s->count: 0, _timeline_percentile(s, 50) / 1000.0,
+                _timeline_percentile(s, 99) / 1000.0, _timeline_percentile(s, 99.9) / 1000.0,
+                s->max / 1000.0);
+    }
+
+    return (fclose(f))? -1: 0;
+}
@@ -0,0 +1,114 @@
+/**
+ * Header file for a timeline of latencies in C, which keeps a
+ * coarse log-linear latency histogram for every second of a run
+ * so that the effect of bursts on the drive can be followed over
+ * time. A timeline is shared by the threads of a drive, each of
+ * which records through a recorder of its own holding only the
+ * last few seconds, so that the memory it takes grows with the
+ * duration of the run but not with the count of threads.
+ *
+ * Author: Yash Gupta <yash_gupta12@live.com>
+ * Copyright: Yash Gupta
+ *
+ * License: MIT Public License
+ */
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#ifndef _TIMELINE_H_
+#define _TIMELINE_H_
+
+/*
+ * Every second gets TIMELINE_SUB_BUCKETS / 2 linear buckets
+ * per power of two, which bounds the relative error of any value
+ * reported to about 6% while keeping a second under 2.5KiB.
+ * Values up to 2^TIMELINE_MAX_BITS nanoseconds are tracked,
+ * anything larger is clamped.
+ */
+#define TIMELINE_SUB_BITS       5
+#define TIMELINE_SUB_BUCKETS    (1 << TIMELINE_SUB_BITS)
+#define TIMELINE_MAX_BITS       40
+#define TIMELINE_BUCKETS        ((TIMELINE_MAX_BITS - TIMELINE_SUB_BITS + 2) * (TIMELINE_SUB_BUCKETS / 2))
+
+/*
+ * A timeline takes about 2.4KiB for every second it spans, some
+ * 4.2MiB for a 30 minute run. A recorder holds TIMELINE_RECENT
+ * seconds of its own, and merges the oldest into its timeline
+ * under the lock of the timeline once its thread moves on past
+ * them, about once a second.
+ */
+#define TIMELINE_RECENT         4
+
+struct timeline_second {
+    uint64_t count;
+    uint64_t bytes;
+    uint64_t total;
+    uint64_t max;
+    uint32_t buckets[TIMELINE_BUCKETS];
+};
+
+typedef struct timeline {
+    uint64_t start;
+    uint64_t seconds;
+    struct timeline_second *slots;
+    pthread_mutex_t lock;
+} timeline;
+
+typedef struct timeline_recorder {
+    timeline *t;
+    uint64_t held[TIMELINE_RECENT];
+    struct timeline_second slots[TIMELINE_RECENT];
+} timeline_recorder;
+
+/**
+ * Create a timeline of a number of seconds from a time stamp
+ * on.
+ */
+timeline*
+timeline_create(uint64_t start, uint64_t seconds);
+
+/**
+ * Deallocate a timeline.
+ */
+void
+timeline_free(timeline *t);
+
+/**
+ * Record a request completed at a time stamp in a timeline.
+ */
+void
+timeline_record(timeline *t, uint64_t when, uint64_t bytes, uint64_t latency);
+
+/**
+ * Add every request recorded in src to dst.
+ */
+void
+timeline_merge(timeline *dst, timeline *src);
+
+/**
+ * Create a recorder of the requests of a thread into a timeline.
+ */
+timeline_recorder*
+timeline_recorder_create(timeline *t);
+
+/**
+ * Record a request completed at a time stamp through a recorder.
+ */
+void
+timeline_recorder_record(timeline_recorder *r, uint64_t when, uint64_t bytes, uint64_t latency);
+
+/**
+ * Merge whatever a recorder holds into its timeline and
+ * deallocate the recorder.
+ */
+void
+timeline_recorder_free(timeline_recorder *r);
+
+/**
+ * Write a timeline out as CSV, a second per line.
+ */
+int
+timeline_write(timeline *t, const char *path);
+
+#endif
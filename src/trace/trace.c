@@ -0,0 +1,301 @@
+/**
+ * Source file for compiled workload traces in C. A trace is
+ * a header followed by fixed size records, one per arrival,
+ * which is memory mapped for replay so that issuing a request
+ * takes no more than reading its record.
+ *
+ * Author: Yash Gupta <yash_gupta12@live.com>
+ * Copyright: Yash Gupta
+ *
+ * License: MIT Public License
+ */
+#include "trace.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <string.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+/**
+ * Create a trace file to compile records into. Room for the
+ * header is left at the start of the file, the header itself
+ * is only written once the count of records is known.
+ *
+ * @param   path        Path of the trace file.
+ * @param   seed        Seed the trace is generated from.
+ * @param   drive_size  Size of the drive offsets are drawn for.
+ * @param   align       Alignment of the offsets and lengths.
+ *
+ * @return  A trace.
+ * @return  NULL        malloc failed.
+ * @return  NULL        fopen failed.
+ */
+trace*
+trace_create(const char *path, uint64_t seed, uint64_t drive_size, uint64_t align)
+{
+    trace *t;
+
+    t = calloc(1, sizeof *t);
+    if (!t) {
+        return NULL;
+    }
+
+    t->file = fopen(path, "wb");
+    if (!t->file) {
+        free(t);
+        return NULL;
+    }
+
+    memcpy(t->pending.magic, TRACE_MAGIC, sizeof TRACE_MAGIC);
+    t->pending.version = TRACE_VERSION;
+    t->pending.record_size = sizeof(struct trace_record);
+    t->pending.seed = seed;
+    t->pending.drive_size = drive_size;
+    t->pending.align = align;
+    t->header = &t->pending;
+
+    if (fseek(t->file, sizeof(struct trace_header), SEEK_SET)) {
+        fclose(t->file);
+        free(t);
+        return NULL;
+    }
+
+    return t;
+}
+
+/**
+ * Append a record to a trace being compiled.
+ *
+ * @param   t       The trace to append to.
+ * @param   record  The record to append.
+ *
+ * @return  0       Successfully appended.
+ * @return  -1      fwrite failed.
+ */
+int
+trace_append(trace *t, struct trace_record *record)
+{
+    if (fwrite(record, sizeof *record, 1, t->file) != 1) {
+        return -1;
+    }
+
+    t->pending.count++;
+    if (record->length > t->pending.max_length) {
+        t->pending.max_length = record->length;
+    }
+
+    return 0;
+}
+
+/**
+ * Write out the header of a trace being compiled and close
+ * it. The trace is freed either way.
+ *
+ * @param   t           The trace to finish.
+ * @param   duration    Nanoseconds the trace spans.
+ *
+ * @return  0           Successfully written.
+ * @return  -1          Writing the header or closing failed.
+ */
+int
+trace_finish(trace *t, uint64_t duration)
+{
+    int ret = 0;
+
+    t->pending.duration = duration;
+    if (fseek(t->file, 0, SEEK_SET) ||
+        fwrite(&t->pending, sizeof t->pending, 1, t->file) != 1) {
+        ret = -1;
+    }
+    if (fclose(t->file)) {
+        ret = -1;
+    }
+
+    free(t);
+    return ret;
+}
+
+/**
+ * Parse a time stamp in seconds with up to nine decimals into
+ * nanoseconds without going through a double, which would lose
+ * precision on long traces.
+ *
+ * @param   str     The time stamp.
+ * @param   ns      Where to store the time in nanoseconds.
+ *
+ * @return  0       Successfully parsed.
+ * @return  -1      str is not a time stamp.
+ */
+static int
+_trace_parse_time(const char *str, uint64_t *ns)
+{
+    uint64_t sec = 0, frac = 0, scale = 1000000000ULL;
+
+    if (!isdigit((unsigned char)*str)) {
+        return -1;
+    }
+    for (; isdigit((unsigned char)*str); str++) {
+        sec = sec * 10 + (*str - '0');
+    }
+    if (*str == '.') {
+        for (str++; isdigit((unsigned char)*str); str++) {
+            if (scale > 1) {
+                scale /= 10;
+                frac += (*str - '0') * scale;
+            }
+        }
+    }
+
+    *ns = sec * 1000000000ULL + frac;
+    return 0;
+}
+
+/**
+ * Parse a single line of a text trace. Two formats are taken,
+ * told apart by the " + " blkparse puts between the sector and
+ * the count.
+ *
+ *  --> CSV: timestamp,op,offset,length with the timestamp in
+ *      seconds, op starting with r or w and the offset and
+ *      length in bytes.
+ *  --> blkparse: the default output of blkparse. Only queue (Q)
+ *      events are taken, as they mark the arrival of a request
+ *      at the block layer. Sectors are 512 bytes.
+ *
+ * @param   line    The line to parse.
+ * @param   event   Where to store the request.
+ *
+ * @return  1       A request was parsed.
+ * @return  0       The line holds no read or write request,
+ *                  e.g. a comment, another event or a flush.
+ * @return  -1      The line is malformed.
+ */
+int
+trace_parse(const char *line, struct trace_event *event)
+{
+    char time[32], op[16], action[8], rwbs[8];
+    unsigned long long offset, length;
+
+    while (isspace((unsigned char)*line)) {
+        line++;
+    }
+    if (!*line || *line == '#') {
+        return 0;
+    }
+
+    if (!strstr(line, " + ")) {
+        if (sscanf(line, " %31[^, ] , %15[^, ] , %llu , %llu", time, op, &offset, &length) != 4 ||
+            _trace_parse_time(time, &event->time)) {
+            return -1;
+        }
+
+        switch (tolower((unsigned char)op[0])) {
+        case 'r':
+            event->write = 0;
+            break;
+        case 'w':
+            event->write = 1;
+            break;
+        default:
+            return 0;
+        }
+        event->offset = offset;
+        event->length = length;
+    } else {
+        // maj,min cpu sequence time pid action rwbs sector + count
+        if (sscanf(line, "%*s %*s %*s %31s %*s %7s %7s %llu + %llu",
+                   time, action, rwbs, &offset, &length) != 5) {
+            return 0;
+        }
+        if (strcmp(action, "Q") || strchr(rwbs, 'D') || _trace_parse_time(time, &event->time)) {
+            return 0;
+        }
+
+        if (strchr(rwbs, 'W')) {
+            event->write = 1;
+        } else if (strchr(rwbs, 'R')) {
+            event->write = 0;
+        } else {
+            return 0;
+        }
+        event->offset = offset * 512;
+        event->length = length * 512;
+    }
+
+    return (event->length)? 1: 0;
+}
+
+/**
+ * Open a compiled trace for replay. The whole file is mapped
+ * read only and prefaulted, and the kernel is told it will be
+ * read sequentially.
+ *
+ * @param   path    Path of the trace file.
+ *
+ * @return  A trace.
+ * @return  NULL    malloc failed.
+ * @return  NULL    The file could not be opened or mapped.
+ * @return  NULL    The file is not a trace of this version.
+ * @return  NULL    The file is shorter than its header claims.
+ */
+trace*
+trace_open(const char *path)
+{
+    struct stat st;
+    trace *t;
+    int fd;
+
+    t = calloc(1, sizeof *t);
+    if (!t) {
+        return NULL;
+    }
+
+    fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        goto open_fail;
+    }
+    if (fstat(fd, &st) || (size_t)st.st_size < sizeof(struct trace_header)) {
+        goto map_fail;
+    }
+
+    t->map_len = st.st_size;
+    t->map = mmap(NULL, t->map_len, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+    if (t->map == MAP_FAILED) {
+        goto map_fail;
+    }
+    close(fd);
+    madvise(t->map, t->map_len, MADV_SEQUENTIAL);
+
+    t->header = t->map;
+    t->records = (struct trace_record*)(t->header + 1);
+    if (memcmp(t->header->magic, TRACE_MAGIC, sizeof TRACE_MAGIC) ||
+        t->header->version != TRACE_VERSION ||
+        t->header->record_size != sizeof(struct trace_record) ||
+        t->header->count > (t->map_len - sizeof *t->header) / sizeof(struct trace_record)) {
+        munmap(t->map, t->map_len);
+        goto open_fail;
+    }
+
+    return t;
+
+map_fail:
+    close(fd);
+
+open_fail:
+    free(t);
+
+    return NULL;
+}
+
+/**
+ * Unmap a trace opened for replay.
+ *
+ * @param   t   The trace to free.
+ */
+void
+trace_free(trace *t)
+{
+    munmap(t->map, t->map_len);
+    free(t);
+}
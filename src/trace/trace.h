@@ -0,0 +1,118 @@
+/**
+ * Header file for compiled workload traces in C. A trace is
+ * a header followed by fixed size records, one per arrival,
+ * which is memory mapped for replay so that issuing a request
+ * takes no more than reading its record.
+ *
+ * Author: Yash Gupta <yash_gupta12@live.com>
+ * Copyright: Yash Gupta
+ *
+ * License: MIT Public License
+ */
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <errno.h>
+
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+#define TRACE_MAGIC     "IOTRACE"
+#define TRACE_VERSION   2
+
+/*
+ * Traces are written in the byte order of the machine that
+ * compiled them. Arrivals are in nanoseconds from the start of
+ * the run and never decrease. The task is the class of the
+ * profile the trace was compiled with, or an enum iotask for an
+ * imported trace. Whether the request writes is recorded on its
+ * own, so that replaying under another profile never turns a
+ * read into a write.
+ */
+struct trace_record {
+    uint64_t arrival;
+    uint64_t offset;
+    uint32_t length;
+    uint16_t task;
+    uint8_t write;
+    uint8_t reserved;
+};
+
+struct trace_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    uint64_t count;
+
+    // Parameters the trace was compiled with.
+    uint64_t seed;
+    uint64_t drive_size;
+    uint64_t align;
+    uint64_t duration;
+
+    // Largest length of any record.
+    uint64_t max_length;
+};
+
+/*
+ * A single request parsed out of a text trace. The time is in
+ * nanoseconds on whatever time line the text trace uses.
+ */
+struct trace_event {
+    uint64_t time;
+    uint64_t offset;
+    uint64_t length;
+    uint8_t write;
+};
+
+typedef struct trace {
+    struct trace_header *header;
+    struct trace_record *records;
+
+    // Mapping of a trace opened for replay.
+    void *map;
+    size_t map_len;
+
+    // File of a trace being compiled.
+    FILE *file;
+    struct trace_header pending;
+} trace;
+
+/**
+ * Create a trace file to compile records into.
+ */
+trace*
+trace_create(const char *path, uint64_t seed, uint64_t drive_size, uint64_t align);
+
+/**
+ * Append a record to a trace being compiled.
+ */
+int
+trace_append(trace *t, struct trace_record *record);
+
+/**
+ * Write out the header of a trace being compiled and close it.
+ */
+int
+trace_finish(trace *t, uint64_t duration);
+
+/**
+ * Parse a single line of a text trace, either a CSV line of
+ * timestamp,op,offset,length or a line of blkparse output.
+ */
+int
+trace_parse(const char *line, struct trace_event *event);
+
+/**
+ * Open a compiled trace for replay.
+ */
+trace*
+trace_open(const char *path);
+
+/**
+ * Unmap a trace opened for replay.
+ */
+void
+trace_free(trace *t);
+
+#endif
@@ -0,0 +1,303 @@
+/**
+ * Source file for a minimal io_uring wrapper in C. Only
+ * the raw system calls are used so that the benchmark does
+ * not depend on liburing being installed.
+ *
+ * Author: Yash Gupta <yash_gupta12@live.com>
+ * Copyright: Yash Gupta
+ *
+ * License: MIT Public License
+ */
+#include "uring.h"
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <string.h>
+#include <unistd.h>
+
+/**
+ * Create an io_uring instance with room for the specified
+ * number of submission entries. The kernel may round the
+ * number of entries up to a power of two.
+ *
+ * Waits are bounded by passing a timeout along with them, which
+ * needs IORING_FEAT_EXT_ARG (Linux 5.11). A kernel without it
+ * could only wait indefinitely, so no ring is created there.
+ *
+ * @param   entries     Count of submission entries.
+ *
+ * @return  A ring.
+ * @return  NULL        malloc failed.
+ * @return  NULL        io_uring_setup failed.
+ * @return  NULL        The kernel cannot bound a wait.
+ * @return  NULL        mmap failed.
+ */
+uring*
+uring_create(unsigned entries)
+{
+    struct io_uring_params p;
+    uring *r;
+    void *sq, *cq;
+
+    r = malloc(sizeof *r);
+    if (!r) {
+        return NULL;
+    }
+
+    memset(&p, 0, sizeof p);
+    r->fd = syscall(__NR_io_uring_setup, entries, &p);
+    if (r->fd < 0) {
+        goto setup_fail;
+    }
+    r->features = p.features;
+    if (!(r->features & IORING_FEAT_EXT_ARG)) {
+        goto feature_fail;
+    }
+
+    /*
+     * The submission and completion rings might share a
+     * single mapping on newer kernels. In that case map the
+     * larger of the two sizes once and point both at it.
+     */
+    r->sq_ring_sz = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    r->cq_ring_sz = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (r->features & IORING_FEAT_SINGLE_MMAP) {
+        if (r->cq_ring_sz > r->sq_ring_sz) {
+            r->sq_ring_sz = r->cq_ring_sz;
+        }
+        r->cq_ring_sz = r->sq_ring_sz;
+    }
+
+    sq = mmap(NULL, r->sq_ring_sz, PROT_READ | PROT_WRITE,
+              MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQ_RING);
+    if (sq == MAP_FAILED) {
+        goto sq_map_fail;
+    }
+
+    if (r->features & IORING_FEAT_SINGLE_MMAP) {
+        cq = sq;
+    } else {
+        cq = mmap(NULL, r->cq_ring_sz, PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_CQ_RING);
+        if (cq == MAP_FAILED) {
+            goto cq_map_fail;
+        }
+    }
+    r->sq_ring = sq;
+    r->cq_ring = cq;
+
+    r->sqes_sz = p.sq_entries * sizeof(struct io_uring_sqe);
+    r->sqes = mmap(NULL, r->sqes_sz, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQES);
+    if (r->sqes == MAP_FAILED) {
+        goto sqes_map_fail;
+    }
+
+    r->sq_head = (unsigned*)((char*)sq + p.sq_off.head);
+    r->sq_tail = (unsigned*)((char*)sq + p.sq_off.tail);
+    r->sq_mask = (unsigned*)((char*)sq + p.sq_off.ring_mask);
+    r->sq_array = (unsigned*)((char*)sq + p.sq_off.array);
+    r->sq_entries = p.sq_entries;
+    r->sq_pending = 0;
+
+    r->cq_head = (unsigned*)((char*)cq + p.cq_off.head);
+    r->cq_tail = (unsigned*)((char*)cq + p.cq_off.tail);
+    r->cq_mask = (unsigned*)((char*)cq + p.cq_off.ring_mask);
+    r->cqes = (struct io_uring_cqe*)((char*)cq + p.cq_off.cqes);
+    r->cq_entries = p.cq_entries;
+
+    return r;
+
+sqes_map_fail:
+    if (cq != sq) {
+        munmap(cq, r->cq_ring_sz);
+    }
+
+cq_map_fail:
+    munmap(sq, r->sq_ring_sz);
+
+sq_map_fail:
+feature_fail:
+    close(r->fd);
+
+setup_fail:
+    free(r);
+
+    return NULL;
+}
+
+/**
+ * Deallocate an io_uring instance and all its mappings.
+ *
+ * @param   r   The ring to deallocate.
+ */
+void
+uring_free(uring *r)
+{
+    munmap(r->sqes, r->sqes_sz);
+    if (r->cq_ring != r->sq_ring) {
+        munmap(r->cq_ring, r->cq_ring_sz);
+    }
+    munmap(r->sq_ring, r->sq_ring_sz);
+    close(r->fd);
+    free(r);
+}
+
+/**
+ * Register a set of buffers with the kernel. Operations
+ * using IORING_OP_{READ,WRITE}_FIXED then refer to these
+ * by index and skip the per request page pinning.
+ *
+ * @param   r       The ring to register buffers with.
+ * @param   iov     The buffers to register.
+ * @param   count   The number of buffers.
+ *
+ * @return  0       Successfully registered.
+ * @return  -1      io_uring_register failed.
+ */
+int
+uring_register_buffers(uring *r, struct iovec *iov, unsigned count)
+{
+    return (syscall(__NR_io_uring_register, r->fd,
+                    IORING_REGISTER_BUFFERS, iov, count) < 0)? -1: 0;
+}
+
+/**
+ * Register a set of file descriptors with the kernel.
+ * Operations flagged with IOSQE_FIXED_FILE then refer to
+ * these by index instead of by descriptor.
+ *
+ * @param   r       The ring to register files with.
+ * @param   fds     The descriptors to register.
+ * @param   count   The number of descriptors.
+ *
+ * @return  0       Successfully registered.
+ * @return  -1      io_uring_register failed.
+ */
+int
+uring_register_files(uring *r, int *fds, unsigned count)
+{
+    return (syscall(__NR_io_uring_register, r->fd,
+                    IORING_REGISTER_FILES, fds, count) < 0)? -1: 0;
+}
+
+/**
+ * Acquire the next free submission entry. The entry is
+ * zeroed and only becomes visible to the kernel once it is
+ * submitted.
+ *
+ * @param   r       The ring to acquire an entry from.
+ *
+ * @return  sqe     A zeroed submission entry.
+ * @return  NULL    The submission ring is full.
+ */
+struct io_uring_sqe*
+uring_get_sqe(uring *r)
+{
+    struct io_uring_sqe *sqe;
+    unsigned head, tail;
+
+    head = __atomic_load_n(r->sq_head, __ATOMIC_ACQUIRE);
+    tail = *r->sq_tail + r->sq_pending;
+    if (tail - head >= r->sq_entries) {
+        return NULL;
+    }
+
+    sqe = &r->sqes[tail & *r->sq_mask];
+    memset(sqe, 0, sizeof *sqe);
+    r->sq_array[tail & *r->sq_mask] = tail & *r->sq_mask;
+    r->sq_pending++;
+
+    return sqe;
+}
+
+/**
+ * Submit all prepared entries and optionally wait for a
+ * minimum number of completions.
+ *
+ * The kernel may take in fewer entries than it is handed, in
+ * which case it does not wait either. Submission is retried for
+ * the rest for as long as the kernel keeps taking entries in.
+ * Entries it leaves in the ring go along with the next submit.
+ *
+ * @param   r           The ring to submit on.
+ * @param   wait_nr     Completions to wait for (0 does not wait).
+ * @param   timeout_ns  Upper bound on the wait, 0 for none.
+ *
+ * @return  count       The number of entries submitted, short of
+ *                      those prepared if the kernel stopped
+ *                      taking them in.
+ * @return  -1          io_uring_enter failed.
+ *
+ * NOTE: An expired timeout is not treated as a failure.
+ */
+int
+uring_submit(uring *r, unsigned wait_nr, uint64_t timeout_ns)
+{
+    struct io_uring_getevents_arg arg;
+    struct __kernel_timespec ts;
+    unsigned head, tail, submit, done, flags;
+    int ret;
+
+    tail = *r->sq_tail + r->sq_pending;
+    if (r->sq_pending) {
+        __atomic_store_n(r->sq_tail, tail, __ATOMIC_RELEASE);
+        r->sq_pending = 0;
+    }
+
+    head = __atomic_load_n(r->sq_head, __ATOMIC_ACQUIRE);
+    submit = tail - head;
+    if (!submit && !wait_nr) {
+        return 0;
+    }
+
+    flags = (wait_nr)? IORING_ENTER_GETEVENTS: 0;
+    if (wait_nr && timeout_ns) {
+        ts.tv_sec = timeout_ns / 1000000000ULL;
+        ts.tv_nsec = timeout_ns % 1000000000ULL;
+        memset(&arg, 0, sizeof arg);
+        arg.ts = (uint64_t)(uintptr_t)&ts;
+        flags |= IORING_ENTER_EXT_ARG;
+    }
+
+    for (done = 0;;) {
+        ret = syscall(__NR_io_uring_enter, r->fd, submit - done, wait_nr, flags,
+                      (flags & IORING_ENTER_EXT_ARG)? &arg: NULL,
+                      (flags & IORING_ENTER_EXT_ARG)? sizeof arg: 0);
+        if (ret < 0 && errno != ETIME && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+            return -1;
+        }
+
+        // The kernel moves the head past whatever it took in.
+        ret = __atomic_load_n(r->sq_head, __ATOMIC_ACQUIRE) - head - done;
+        done += ret;
+        if (done == submit || ret <= 0) {
+            return done;
+        }
+    }
+}
+
+/**
+ * Copy completion entries out of the completion ring and
+ * release them back to the kernel.
+ *
+ * @param   r       The ring to reap from.
+ * @param   cqes    Array to copy the completions into.
+ * @param   count   Capacity of cqes.
+ *
+ * @return  count   The number of completions reaped.
+ */
+unsigned
+uring_reap(uring *r, struct io_uring_cqe *cqes, unsigned count)
+{
+    unsigned head, tail, i;
+
+    head = *r->cq_head;
+    tail = __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE);
+
+    for (i = 0; head != tail && i < count; head++, i++) {
+        cqes[i] = r->cqes[head & *r->cq_mask];
+    }
+
+    __atomic_store_n(r->cq_head, head, __ATOMIC_RELEASE);
+    return i;
+}
@@ -0,0 +1,90 @@
+/**
+ * Header file for a minimal io_uring wrapper in C. Only
+ * the raw system calls are used so that the benchmark does
+ * not depend on liburing being installed.
+ *
+ * Author: Yash Gupta <yash_gupta12@live.com>
+ * Copyright: Yash Gupta
+ *
+ * License: MIT Public License
+ */
+#include <linux/io_uring.h>
+#include <sys/uio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+
+#ifndef _URING_H_
+#define _URING_H_
+
+typedef struct uring {
+    int fd;
+    uint32_t features;
+
+    // Submission ring.
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    unsigned sq_entries, sq_pending;
+    struct io_uring_sqe *sqes;
+
+    // Completion ring.
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    unsigned cq_entries;
+    struct io_uring_cqe *cqes;
+
+    // Mappings to release on free.
+    void *sq_ring, *cq_ring;
+    size_t sq_ring_sz, cq_ring_sz, sqes_sz;
+} uring;
+
+/**
+ * Create an io_uring instance with room for the specified
+ * number of submission entries, on kernels which can bound a
+ * wait by a timeout.
+ */
+uring*
+uring_create(unsigned entries);
+
+/**
+ * Deallocate an io_uring instance and all its mappings.
+ */
+void
+uring_free(uring *r);
+
+/**
+ * Register a set of buffers with the kernel so that fixed
+ * buffer operations do not need to pin pages per request.
+ */
+int
+uring_register_buffers(uring *r, struct iovec *iov, unsigned count);
+
+/**
+ * Register a set of file descriptors with the kernel so that
+ * fixed file operations do not need a file lookup per request.
+ */
+int
+uring_register_files(uring *r, int *fds, unsigned count);
+
+/**
+ * Acquire the next free submission entry. The entry is
+ * zeroed and only becomes visible to the kernel on submit.
+ */
+struct io_uring_sqe*
+uring_get_sqe(uring *r);
+
+/**
+ * Submit all prepared entries and optionally wait for a
+ * minimum number of completions, for at most timeout_ns
+ * nanoseconds (0 waits indefinitely). Returns how many entries
+ * the kernel took in, which may fall short of those prepared.
+ */
+int
+uring_submit(uring *r, unsigned wait_nr, uint64_t timeout_ns);
+
+/**
+ * Copy up to count completion entries out of the completion
+ * ring and release them back to the kernel.
+ */
+unsigned
+uring_reap(uring *r, struct io_uring_cqe *cqes, unsigned count);
+
+#endif
@@ -0,0 +1,656 @@
+/**
+ * Source for mainting work profiles used to model
+ * arbitrary workloads.
+ *
+ * Author: Yash Gupta <yash_gupta12@live.com>
+ * Copyright: Yash Gupta
+ *
+ * License: MIT Public License
+ */
+#define _GNU_SOURCE
+#include "work_profile.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+/**
+ * Build an alias table with Vose's method. Columns holding less
+ * than their share are topped up by an entry holding more, until
+ * every column holds exactly its share.
+ *
+ * @param   weights     Weights of the entries.
+ * @param   count       Count of entries.
+ * @param   threshold   Thresholds of the columns, to fill in.
+ * @param   alias       Aliases of the columns, to fill in.
+ *
+ * @return  0           Successfully built.
+ * @return  -1          There are no entries, or no weight.
+ */
+static int
+_alias_build(const double *weights, uint32_t count, uint64_t *threshold, uint32_t *alias)
+{
+    double scaled[MAX_CLASSES], total;
+    uint32_t small[MAX_CLASSES], large[MAX_CLASSES];
+    uint32_t nsmall, nlarge, s, l, i;
+
+    total = 0;
+    for (i = 0; i < count; i++) {
+        total += weights[i];
+    }
+    if (!count || !(total > 0)) {
+        return -1;
+    }
+
+    nsmall = nlarge = 0;
+    for (i = 0; i < count; i++) {
+        scaled[i] = weights[i] * count / total;
+        if (scaled[i] < 1) {
+            small[nsmall++] = i;
+        } else {
+            large[nlarge++] = i;
+        }
+    }
+
+    while (nsmall && nlarge) {
+        s = small[--nsmall];
+        l = large[--nlarge];
+
+        threshold[s] = scaled[s] * 4294967296.0;
+        alias[s] = l;
+
+        scaled[l] -= 1 - scaled[s];
+        if (scaled[l] < 1) {
+            small[nsmall++] = l;
+        } else {
+            large[nlarge++] = l;
+        }
+    }
+
+    // Whatever is left holds its share up to rounding errors.
+    while (nlarge) {
+        l = large[--nlarge];
+        threshold[l] = 4294967296ULL;
+        alias[l] = l;
+    }
+    while (nsmall) {
+        s = small[--nsmall];
+        threshold[s] = 4294967296ULL;
+        alias[s] = s;
+    }
+
+    return 0;
+}
+
+/**
+ * Acquire the quantile of the standard normal distribution at
+ * p, with the rational approximation of Acklam, which is good to
+ * about 1e-9. The central 95% only costs a pair of polynomials.
+ *
+ * @param   p       Probability, in (0, 1).
+ *
+ * @return  z       The quantile.
+ */
+static double
+_normal_quantile(double p)
+{
+    static const double a[] = {-3.969683028665376e+01, 2.209460984245205e+02, -2.759285104469687e+02,
+                               1.383577518672690e+02, -3.066479806614716e+01, 2.506628277459239e+00};
+    static const double b[] = {-5.447609879822406e+01, 1.615858368580409e+02, -1.556989798598866e+02,
+                               6.680131188771972e+01, -1.328068155288572e+01};
+    static const double c[] = {-7.784894002430293e-03, -3.223964580411365e-01, -2.400758277161838e+00,
+                               -2.549671324505306e+00, 4.374664141464968e+00, 2.938163982698783e+00};
+    static const double d[] = {7.784695709041462e-03, 3.224671290700398e-01, 2.445134137142996e+00,
+                               3.754408661907416e+00};
+    double q, r;
+
+    if (p < 0.02425 || p > 0.97575) {
+        q = sqrt(-2 * log((p < 0.5)? p: 1 - p));
+        r = (((((c[0] * q + c[1]) * q + c[2]) * q + c[3]) * q + c[4]) * q + c[5]) /
+            ((((d[0] * q + d[1]) * q + d[2]) * q + d[3]) * q + 1);
+        return (p < 0.5)? r: -r;
+    }
+
+    q = p - 0.5;
+    r = q * q;
+    return (((((a[0] * r + a[1]) * r + a[2]) * r + a[3]) * r + a[4]) * r + a[5]) * q /
+           (((((b[0] * r + b[1]) * r + b[2]) * r + b[3]) * r + b[4]) * r + 1);
+}
+
+/**
+ * Parse a size distribution, one of:
+ *
+ *  BYTES                           A fixed size.
+ *  uniform:MIN:MAX                 Any size in [MIN, MAX].
+ *  lognormal:MEDIAN:SIGMA:MAX      Log-normal, clamped to MAX.
+ *  hist:SIZE@WEIGHT,...            Up to SIZE_POINTS weighted sizes.
+ *
+ * Eg: "hist:4096@60,65536@30,1048576@10"
+ *
+ * @param   s       The distribution to fill in.
+ * @param   text    The text to parse.
+ *
+ * @return  0       Successfully parsed.
+ * @return  -1      The text is malformed.
+ */
+int
+work_size_parse(struct work_size *s, const char *text)
+{
+    double median;
+    char *end;
+
+    memset(s, 0, sizeof *s);
+    if (!strncmp(text, "uniform:", 8)) {
+        s->distribution = SIZE_UNIFORM;
+        s->min = strtoull(text + 8, &end, 0);
+        if (*end != ':') {
+            return -1;
+        }
+        s->max = strtoull(end + 1, &end, 0);
+        return (*end || !s->min || s->min > s->max)? -1: 0;
+    }
+
+    if (!strncmp(text, "lognormal:", 10)) {
+        s->distribution = SIZE_LOGNORMAL;
+        median = strtod(text + 10, &end);
+        if (*end != ':') {
+            return -1;
+        }
+        s->sigma = strtod(end + 1, &end);
+        if (*end != ':') {
+            return -1;
+        }
+        s->max = strtoull(end + 1, &end, 0);
+        s->min = 1;
+        s->mu = log(median);
+        return (*end || !(median >= 1) || !(s->sigma >= 0) || !s->max)? -1: 0;
+    }
+
+    if (!strncmp(text, "hist:", 5)) {
+        s->distribution = SIZE_HISTOGRAM;
+        end = (char*)text + 4;
+        do {
+            if (s->count == SIZE_POINTS) {
+                return -1;
+            }
+            s->sizes[s->count] = strtoull(end + 1, &end, 0);
+            if (*end != '@') {
+                return -1;
+            }
+            s->weights[s->count] = strtod(end + 1, &end);
+            if (!s->sizes[s->count] || !(s->weights[s->count] >= 0)) {
+                return -1;
+            }
+            s->min = (!s->count || s->sizes[s->count] < s->min)? s->sizes[s->count]: s->min;
+            s->max = (s->sizes[s->count] > s->max)? s->sizes[s->count]: s->max;
+            s->count++;
+        } while (*end == ',');
+        return (*end)? -1: _alias_build(s->weights, s->count, s->threshold, s->alias);
+    }
+
+    s->distribution = SIZE_FIXED;
+    s->min = s->max = strtoull(text, &end, 0);
+    return (*end || *text == '-')? -1: 0;
+}
+
+/**
+ * Draw a size out of a distribution which is not fixed.
+ *
+ * @param   s       The distribution.
+ * @param   r       Random stream of the calling thread.
+ *
+ * @return  size    The size drawn, before alignment.
+ */
+uint64_t
+work_size_draw(struct work_size *s, rng *r)
+{
+    double p, size;
+
+    switch (s->distribution) {
+        case SIZE_UNIFORM:
+            return s->min + rng_bounded(r, s->max - s->min + 1);
+
+        case SIZE_HISTOGRAM:
+            return s->sizes[work_alias_draw(rng_next(r), s->count, s->threshold, s->alias)];
+
+        case SIZE_LOGNORMAL:
+            p = rng_uniform(r);
+            if (p >= 1) {
+                return s->max;
+            }
+            size = exp(s->mu + s->sigma * _normal_quantile(p));
+            if (size >= s->max) {
+                return s->max;
+            }
+            return (size < s->min)? s->min: (uint64_t)size;
+
+        default:
+            return s->min;
+    }
+}
+
+/**
+ * Helpers of rejection-inversion, which stay accurate for
+ * exponents close to 1 where (1 - theta) vanishes.
+ */
+static inline double
+_helper1(double x)
+{
+    return (fabs(x) > 1e-8)? log1p(x) / x: 1 - x * (0.5 - x * (1.0 / 3 - 0.25 * x));
+}
+
+static inline double
+_helper2(double x)
+{
+    return (fabs(x) > 1e-8)? expm1(x) / x: 1 + x * 0.5 * (1 + x * (1.0 / 3) * (1 + 0.25 * x));
+}
+
+// The hat function h(x) = x^-theta, its integral H and its inverse.
+static inline double
+_zipf_h(double theta, double x)
+{
+    return exp(-theta * log(x));
+}
+
+static inline double
+_zipf_hintegral(double theta, double x)
+{
+    double l = log(x);
+
+    return _helper2((1 - theta) * l) * l;
+}
+
+static inline double
+_zipf_hinverse(double theta, double x)
+{
+    double t = x * (1 - theta);
+
+    return exp(_helper1((t < -1)? -1: t) * x);
+}
+
+static uint64_t
+_gcd(uint64_t a, uint64_t b)
+{
+    uint64_t t;
+
+    while (b) {
+        t = a % b;
+        a = b;
+        b = t;
+    }
+
+    return a;
+}
+
+/**
+ * Parse an offset distribution, one of:
+ *
+ *  uniform                         Uniform over the drive.
+ *  zipf:THETA                      Zipf with exponent THETA > 0.
+ *  hotspot:IO:SPACE                IO% of requests to SPACE% of the drive.
+ *
+ * Eg: "hotspot:80:20"
+ *
+ * @param   o       The distribution to fill in.
+ * @param   text    The text to parse.
+ *
+ * @return  0       Successfully parsed.
+ * @return  -1      The text is malformed.
+ */
+int
+work_offset_parse(struct work_offset *o, const char *text)
+{
+    char *end;
+
+    memset(o, 0, sizeof *o);
+    if (!strcmp(text, "uniform")) {
+        o->distribution = OFFSET_UNIFORM;
+        return 0;
+    }
+
+    if (!strncmp(text, "zipf:", 5)) {
+        o->distribution = OFFSET_ZIPF;
+        o->theta = strtod(text + 5, &end);
+        return (*end || !(o->theta > 0))? -1: 0;
+    }
+
+    if (!strncmp(text, "hotspot:", 8)) {
+        o->distribution = OFFSET_HOTSPOT;
+        o->hot_io = strtod(text + 8, &end) / 100;
+        if (*end != ':') {
+            return -1;
+        }
+        o->hot_space = strtod(end + 1, &end) / 100;
+        return (*end || !(o->hot_io >= 0 && o->hot_io <= 1) ||
+                !(o->hot_space > 0 && o->hot_space < 1))? -1: 0;
+    }
+
+    return -1;
+}
+
+/**
+ * Prepare to draw offsets of a distribution over a region of
+ * a drive. Offsets are drawn in whole blocks, so that a drive
+ * of billions of blocks needs no table at all.
+ *
+ * Zipf ranks are scattered over the region by multiplying them
+ * with a step coprime to the count of blocks, close to the
+ * golden ratio of it, which maps every rank to a block of its
+ * own while keeping popular blocks apart.
+ *
+ * @param   s       The sampler to prepare.
+ * @param   o       The distribution.
+ * @param   size    Size of the region.
+ * @param   block   Size of a block.
+ */
+void
+offset_sampler_init(struct offset_sampler *s, const struct work_offset *o, uint64_t size,
+                    uint64_t block)
+{
+    memset(s, 0, sizeof *s);
+    s->distribution = o->distribution;
+    s->block = block;
+    s->blocks = (size / block)? size / block: 1;
+
+    if (o->distribution == OFFSET_ZIPF) {
+        s->theta = o->theta;
+        s->h_x1 = _zipf_hintegral(s->theta, 1.5) - 1;
+        s->h_n = _zipf_hintegral(s->theta, s->blocks + 0.5);
+        s->s = 2 - _zipf_hinverse(s->theta, _zipf_hintegral(s->theta, 2.5) - _zipf_h(s->theta, 2));
+
+        s->step = s->blocks * 0.6180339887498949;
+        s->step = (s->step)? s->step: 1;
+        while (_gcd(s->step, s->blocks) != 1) {
+            s->step++;
+        }
+    } else if (o->distribution == OFFSET_HOTSPOT) {
+        s->hot_blocks = s->blocks * o->hot_space;
+        s->hot_blocks = (s->hot_blocks)? s->hot_blocks: 1;
+        s->hot_threshold = (o->hot_io >= 1)? UINT64_MAX: o->hot_io * 18446744073709551616.0;
+    }
+}
+
+/**
+ * Draw an offset out of a distribution which is not uniform.
+ * Zipf is drawn by the rejection-inversion of Hörmann and
+ * Derflinger, which takes a constant number of draws on
+ * average, whatever the count of blocks and the exponent.
+ *
+ * @param   s       The sampler.
+ * @param   r       Random stream of the calling thread.
+ *
+ * @return  offset  The offset drawn, relative to the region.
+ */
+uint64_t
+offset_sampler_draw(struct offset_sampler *s, rng *r)
+{
+    double u, x, k;
+    uint64_t rank;
+
+    if (s->distribution == OFFSET_ZIPF) {
+        do {
+            u = s->h_n + rng_uniform(r) * (s->h_x1 - s->h_n);
+            x = _zipf_hinverse(s->theta, u);
+            k = (uint64_t)(x + 0.5);
+            k = (k < 1)? 1: (k > s->blocks)? s->blocks: k;
+        } while (k - x > s->s && u < _zipf_hintegral(s->theta, k + 0.5) - _zipf_h(s->theta, k));
+
+        rank = k - 1;
+        return (uint64_t)(((unsigned __int128)rank * s->step) % s->blocks) * s->block;
+    }
+
+    if (s->hot_blocks == s->blocks || rng_next(r) < s->hot_threshold) {
+        return rng_bounded(r, s->hot_blocks) * s->block;
+    }
+
+    return (s->hot_blocks + rng_bounded(r, s->blocks - s->hot_blocks)) * s->block;
+}
+
+/**
+ * Initialize an empty profile, with offsets left unaligned.
+ *
+ * @param   p   The profile to initialize.
+ */
+void
+work_profile_init(struct work_profile *p)
+{
+    memset(p, 0, sizeof *p);
+    p->align = 1;
+}
+
+/**
+ * Add a class to a profile.
+ *
+ * @param   p       The profile to add to.
+ * @param   name    Name of the class.
+ * @param   write   The class writes rather than reads.
+ * @param   access  Access pattern of the class.
+ * @param   weight  Relative weight of the class.
+ * @param   size    Sizes of the requests of the class.
+ *
+ * @return  0       Successfully added.
+ * @return  -1      The profile is full, or the class is invalid.
+ *
+ * NOTE: A class which is never drawn may have no size.
+ */
+static int
+_profile_add(struct work_profile *p, const char *name, uint8_t write,
+             uint8_t access, double weight, const struct work_size *size)
+{
+    struct work_class *c;
+
+    if (p->count == MAX_CLASSES || !(weight >= 0) || (!size->max && weight > 0)) {
+        return -1;
+    }
+
+    c = &p->classes[p->count++];
+    snprintf(c->name, sizeof c->name, "%s", name);
+    c->write = write;
+    c->access = access;
+    c->weight = weight;
+    c->size = *size;
+    c->streams = 1;
+    c->stride = 0;
+
+    return 0;
+}
+
+/**
+ * Add a class of a single size to a profile.
+ *
+ * @param   p       The profile to add to.
+ * @param   name    Name of the class.
+ * @param   write   The class writes rather than reads.
+ * @param   access  Access pattern of the class.
+ * @param   weight  Relative weight of the class.
+ * @param   size    Size of every request of the class.
+ *
+ * @return  0       Successfully added.
+ * @return  -1      The profile is full, or the class is invalid.
+ */
+int
+work_profile_add(struct work_profile *p, const char *name, uint8_t write,
+                 uint8_t access, double weight, uint64_t size)
+{
+    struct work_size fixed;
+
+    memset(&fixed, 0, sizeof fixed);
+    fixed.distribution = SIZE_FIXED;
+    fixed.min = fixed.max = size;
+
+    return _profile_add(p, name, write, access, weight, &fixed);
+}
+
+/**
+ * Add the class described by a line of a profile to a profile.
+ * A class is described by its name followed by any of the keys
+ * below, and anything after a '#' is a comment.
+ *
+ *  op=read|write                   (read)
+ *  access=random|sequential        (random)
+ *  weight=W                        (1, fractions are fine)
+ *  size=DISTRIBUTION               (4096, see work_size_parse)
+ *  offset=DISTRIBUTION             (uniform, see work_offset_parse,
+ *                                  random classes only)
+ *  streams=N                       (1, up to MAX_STREAMS, sequential
+ *                                  classes only)
+ *  stride=BYTES                    (0 for the length of each request,
+ *                                  sequential classes only)
+ *
+ * Eg: "log_append op=write access=sequential weight=35.5 size=16384"
+ *
+ * @param   p       The profile to add to.
+ * @param   line    The line, which is modified.
+ *
+ * @return  0       Successfully added the class, or the line is
+ *                  blank.
+ * @return  -1      The line is malformed.
+ */
+int
+work_profile_parse(struct work_profile *p, char *line)
+{
+    char *name, *key, *value, *save, *end;
+    struct work_size size;
+    struct work_offset offset;
+    uint64_t streams, stride;
+    double weight;
+    uint8_t write, access;
+    int ret = 0;
+
+    if ((end = strchr(line, '#')) != NULL) {
+        *end = '\0';
+    }
+    name = strtok_r(line, " \t\r\n", &save);
+    if (!name) {
+        return 0;
+    }
+
+    write = 0;
+    access = ACCESS_RANDOM;
+    weight = 1;
+    work_size_parse(&size, "4096");
+    work_offset_parse(&offset, "uniform");
+    streams = 1;
+    stride = 0;
+    while (!ret && (key = strtok_r(NULL, " \t\r\n", &save)) != NULL) {
+        value = strchr(key, '=');
+        if (!value) {
+            return -1;
+        }
+        *value++ = '\0';
+
+        if (!strcmp(key, "op") && (!strcmp(value, "read") || !strcmp(value, "write"))) {
+            write = !strcmp(value, "write");
+        } else if (!strcmp(key, "access") && !strcmp(value, "random")) {
+            access = ACCESS_RANDOM;
+        } else if (!strcmp(key, "access") && !strcmp(value, "sequential")) {
+            access = ACCESS_SEQUENTIAL;
+        } else if (!strcmp(key, "weight")) {
+            weight = strtod(value, &end);
+            ret = (*end)? -1: 0;
+        } else if (!strcmp(key, "size")) {
+            ret = work_size_parse(&size, value);
+        } else if (!strcmp(key, "offset")) {
+            ret = work_offset_parse(&offset, value);
+        } else if (!strcmp(key, "streams")) {
+            streams = strtoull(value, &end, 0);
+            ret = (*end || !streams || streams > MAX_STREAMS)? -1: 0;
+        } else if (!strcmp(key, "stride")) {
+            stride = strtoull(value, &end, 0);
+            ret = (*end)? -1: 0;
+        } else {
+            ret = -1;
+        }
+    }
+
+    if (ret || (access == ACCESS_SEQUENTIAL && offset.distribution != OFFSET_UNIFORM) ||
+        (access == ACCESS_RANDOM && (streams != 1 || stride)) ||
+        _profile_add(p, name, write, access, weight, &size)) {
+        return -1;
+    }
+
+    p->classes[p->count - 1].offset = offset;
+    p->classes[p->count - 1].streams = streams;
+    p->classes[p->count - 1].stride = stride;
+
+    return 0;
+}
+
+/**
+ * Add the classes described in a profile file to a profile,
+ * one per line, see work_profile_parse.
+ *
+ * @param   p       The profile to add to.
+ * @param   path    Path of the profile file.
+ *
+ * @return  0       Successfully added every class.
+ * @return  line    Number of the first malformed line.
+ * @return  -1      The file could not be opened.
+ */
+int
+work_profile_load(struct work_profile *p, const char *path)
+{
+    char *line = NULL;
+    size_t cap = 0;
+    FILE *f;
+    int n, ret;
+
+    f = fopen(path, "r");
+    if (!f) {
+        return -1;
+    }
+
+    ret = 0;
+    for (n = 1; !ret && getline(&line, &cap, f) != -1; n++) {
+        ret = (work_profile_parse(p, line))? n: 0;
+    }
+
+    free(line);
+    fclose(f);
+
+    return ret;
+}
+
+/**
+ * Validate a profile and build its alias table.
+ *
+ * @param   p       The profile to finish.
+ *
+ * @return  0       Successfully built.
+ * @return  -1      The profile has no classes, or no weight.
+ */
+int
+work_profile_finish(struct work_profile *p)
+{
+    double weights[MAX_CLASSES];
+    uint32_t i;
+
+    for (i = 0; i < p->count; i++) {
+        weights[i] = p->classes[i].weight;
+    }
+
+    return _alias_build(weights, p->count, p->threshold, p->alias);
+}
+
+/**
+ * Acquire the size of the largest request of a profile.
+ *
+ * @param   p       The profile.
+ *
+ * @return  size    The largest size of any class, rounded up
+ *                  to the alignment of the profile.
+ */
+uint64_t
+work_profile_max_size(struct work_profile *p)
+{
+    uint64_t size = 0;
+    uint32_t i;
+
+    for (i = 0; i < p->count; i++) {
+        if (p->classes[i].size.max > size) {
+            size = p->classes[i].size.max;
+        }
+    }
+
+    return size + (p->align - size % p->align) % p->align;
+}
@@ -1,13 +1,15 @@
 /**
  * Header for mainting work profiles used to model
- * arbitrary workloads. Provides an assertion to confirm
- * validity of profile along with set and deset macros.
- * 
+ * arbitrary workloads. A profile is a set of weighted
+ * operation classes, one of which is drawn for every
+ * item in constant time.
+ *
  * Auhtor: Yash Gupta <yash_gupta12@live.com>
  * Copyright: Yash Gupta
- * 
+ *
  * License: MIT Public License
  */
+#include "rng/rng.h"
 #include <stdint.h>
 #include <assert.h>
 
@@ -17,77 +19,284 @@
 //
 // Macros
 //
-// Max flags value
-#define MAX_FLAGS_VALUE     (1 << PROFILE_FLAGS_END)
-
-// Assert correct profile
-#define ASSERT_PROFILE(p)                                   \
-    do {                                                    \
-        assert(p.flags > 0 && p.flags < MAX_FLAGS_VALUE);   \
-        if (p.swrite_prob != 100) {                         \
-            assert(1 == 0);                                 \
-        }                                                   \
-        /* TODO: Add assert for sizes */                    \
-    } while (0)
-
-// Set and unset flags
-#define SET_PROFILE_FLAG(p, f)      (p.flags |= 1 << f)
-#define UNSET_PROFILE_FLAG(p, f)    (p.flags &= ~(1 << f))
+// Largest number of classes in a profile.
+#define MAX_CLASSES         64
+
+// Length of the name of a class, terminator included.
+#define CLASS_NAME_LEN      32
+
+// Largest number of sizes in a size histogram.
+#define SIZE_POINTS         16
+
+// Largest number of streams of a sequential class.
+#define MAX_STREAMS         64
 
 //
 // Enumerations
 //
-// Profile Flags
-enum profile_flags {
-    RREAD = 0,
-    RWRITE,
-    SREAD,
-    SWRITE,
-    PROFILE_FLAGS_END
+// Access Patterns
+enum access_pattern {
+    ACCESS_RANDOM = 0,
+    ACCESS_SEQUENTIAL
+};
+
+// Size Distributions
+enum size_distribution {
+    SIZE_FIXED = 0,
+    SIZE_UNIFORM,
+    SIZE_LOGNORMAL,
+    SIZE_HISTOGRAM
 };
 
-// 
+// Offset Distributions
+enum offset_distribution {
+    OFFSET_UNIFORM = 0,
+    OFFSET_ZIPF,
+    OFFSET_HOTSPOT
+};
+
+//
 // Structures
 //
+// Request Size
+struct work_size {
+    /*
+     * The size of every request of a class is drawn out of
+     * one of the distributions below. Sizes are rounded up to
+     * the alignment of the profile once drawn.
+     *
+     *  --> Fixed: always min (== max), without a draw.
+     *  --> Uniform: any size in [min, max].
+     *  --> Log-normal: exp(mu + sigma * Z) for a standard
+     *      normal Z, clamped to [min, max].
+     *  --> Histogram: one of count sizes, each drawn with a
+     *      probability proportional to its weight, with an
+     *      alias table of its own.
+     */
+    uint8_t distribution;
+    uint64_t min;
+    uint64_t max;
+    double mu;
+    double sigma;
+
+    uint32_t count;
+    uint64_t sizes[SIZE_POINTS];
+    double weights[SIZE_POINTS];
+    uint64_t threshold[SIZE_POINTS];
+    uint32_t alias[SIZE_POINTS];
+};
+
+// Request Offset
+struct work_offset {
+    /*
+     * The offsets of a random class are either spread
+     * uniformly over the drive, or skewed towards some blocks
+     * so that caches and the hot/cold separation of the drive
+     * come into play.
+     *
+     *  --> Zipf: block k of popularity rank k is drawn with a
+     *      probability proportional to 1 / k^theta. Ranks are
+     *      scattered over the drive rather than packed at its
+     *      start.
+     *  --> Hotspot: a fraction hot_io of the requests go to the
+     *      first fraction hot_space of the drive, the rest to
+     *      the remainder.
+     */
+    uint8_t distribution;
+    double theta;
+    double hot_io;
+    double hot_space;
+};
+
+// Sampler of the offsets of a class over a region of a drive.
+struct offset_sampler {
+    uint8_t distribution;
+    uint64_t block;
+    uint64_t blocks;
+
+    // Zipf, drawn by rejection-inversion.
+    double theta;
+    double h_x1;
+    double h_n;
+    double s;
+    uint64_t step;
+
+    // Hotspot
+    uint64_t hot_blocks;
+    uint64_t hot_threshold;
+};
+
+// Operation Class
+struct work_class {
+    /*
+     * A class is a single kind of operation in a workload,
+     * such as the appends to a log or the reads of an index.
+     * Each class is drawn with a probability proportional to
+     * its weight, and its statistics are kept apart from those
+     * of every other class.
+     */
+    char name[CLASS_NAME_LEN];
+    uint8_t write;
+    uint8_t access;
+    double weight;
+    struct work_size size;
+    struct work_offset offset;
+
+    /*
+     * A sequential class runs as streams independent streams,
+     * each on a region of its own of an equal share of the drive.
+     * Every request of the class goes to one of them, drawn at
+     * random, and the stream moves on by stride bytes, or by the
+     * length of the request for a stride of 0.
+     */
+    uint32_t streams;
+    uint64_t stride;
+};
+
 // Profile Structure
 struct work_profile {
-    uint8_t flags;
-
     /*
      * Using a probability distribution and specific
      * sizes for these fields, we should be able to
-     * benchmark any arbitrary workload. The only 
+     * benchmark any arbitrary workload. The only
      * limitation being that real time specific workloads
      * which work on absolute nature cannot be accurately
      * modeled.
-     * 
+     *
      * Eg: A workload which ALWAYS performs 2 reads followed
-     * by a write and so on. 
-     * --> Such a workload does have a distribution but it is also 
+     * by a write and so on.
+     * --> Such a workload does have a distribution but it is also
      * very much absolute in how the work is given.
-     * 
-     * Legend:
-     * --> r: random
-     * --> s: sequential
-     * 
-     * The basic principle behind the organisation of the probabilities
-     * is that they are cumulative. After a random number is generated,
-     * it is checked on which probability bucket it exists, and then that
-     * wokload is generated.
-     * 
-     * Eg: rread_prob == 10, rwrite_prob == 25, sread_prob == 50, swrite_prob == 15
-     * This distribution would give the following values:
-     *  rread_prob:  [1, 10]
-     *  rwrite_prob: [11, 35]
-     *  sread_prob:  [36, 85]
-     *  swrite_prob: [86, 100]
-     * If a generated random number was 54, a sequential read workload
-     * shall be generated.
      */
-    uint64_t rread_sz, rwrite_sz;
-    uint64_t sread_sz, swrite_sz;
-    uint8_t rread_prob, rwrite_prob;
-    uint8_t sread_prob, swrite_prob;
+    struct work_class classes[MAX_CLASSES];
+    uint32_t count;
+
+    /*
+     * Classes are drawn with the alias method. A single draw
+     * picks a column uniformly and a fraction, which keeps to
+     * the column if it is below the threshold of the column and
+     * moves on to its alias otherwise. Thresholds are fractions
+     * of 2^32, so a threshold of 2^32 always keeps to the column.
+     *
+     * Eg: weights of 10, 25, 50 and 15 scale to 0.4, 1.0, 2.0
+     * and 0.6 columns. Class 2 tops up column 0 with 0.6 and
+     * column 3 with 0.4 and keeps column 2, so that every column
+     * holds exactly a quarter of the probability.
+     */
+    uint64_t threshold[MAX_CLASSES];
+    uint32_t alias[MAX_CLASSES];
+
+    /*
+     * Offsets of all generated work are aligned to this
+     * boundary. Direct I/O requires offsets, lengths and
+     * buffers to be aligned to the logical block size of the
+     * drive. A value of 1 leaves offsets untouched.
+     */
+    uint64_t align;
 };
 
-#endif
\ No newline at end of file
+/**
+ * Initialize an empty profile.
+ */
+void
+work_profile_init(struct work_profile *p);
+
+/**
+ * Add a class to a profile.
+ */
+int
+work_profile_add(struct work_profile *p, const char *name, uint8_t write,
+                 uint8_t access, double weight, uint64_t size);
+
+/**
+ * Add the class described by a line of a profile to a profile.
+ */
+int
+work_profile_parse(struct work_profile *p, char *line);
+
+/**
+ * Add the classes described in a profile file to a profile.
+ */
+int
+work_profile_load(struct work_profile *p, const char *path);
+
+/**
+ * Validate a profile and build its alias table.
+ */
+int
+work_profile_finish(struct work_profile *p);
+
+/**
+ * Acquire the size of the largest request of a profile.
+ */
+uint64_t
+work_profile_max_size(struct work_profile *p);
+
+/**
+ * Parse a size distribution such as "4096", "uniform:MIN:MAX",
+ * "lognormal:MEDIAN:SIGMA:MAX" or "hist:SIZE@WEIGHT,...".
+ */
+int
+work_size_parse(struct work_size *s, const char *text);
+
+/**
+ * Draw a size out of a distribution which is not fixed.
+ */
+uint64_t
+work_size_draw(struct work_size *s, rng *r);
+
+/**
+ * Parse an offset distribution such as "uniform", "zipf:THETA"
+ * or "hotspot:IO%:SPACE%".
+ */
+int
+work_offset_parse(struct work_offset *o, const char *text);
+
+/**
+ * Prepare to draw offsets of a distribution over a region
+ * of a drive, in blocks of a given size.
+ */
+void
+offset_sampler_init(struct offset_sampler *s, const struct work_offset *o, uint64_t size,
+                    uint64_t block);
+
+/**
+ * Draw an offset, aligned to the block of the sampler, out of
+ * a distribution which is not uniform.
+ */
+uint64_t
+offset_sampler_draw(struct offset_sampler *s, rng *r);
+
+/**
+ * Draw a column of an alias table of count columns out of a
+ * single random value. A bias of at most count / 2^32 in the
+ * choice of the column is accepted for needing a single draw.
+ */
+static inline uint32_t
+work_alias_draw(uint64_t x, uint32_t count, const uint64_t *threshold, const uint32_t *alias)
+{
+    uint32_t column = ((x >> 32) * count) >> 32;
+
+    return ((x & 0xffffffffULL) < threshold[column])? column: alias[column];
+}
+
+/**
+ * Draw a class in constant time, however many classes there are.
+ */
+static inline uint32_t
+work_profile_sample(struct work_profile *p, rng *r)
+{
+    return work_alias_draw(rng_next(r), p->count, p->threshold, p->alias);
+}
+
+/**
+ * Draw the size of a request, leaving the random stream
+ * untouched for fixed sizes.
+ */
+static inline uint64_t
+work_size_sample(struct work_size *s, rng *r)
+{
+    return (s->distribution == SIZE_FIXED)? s->min: work_size_draw(s, r);
+}
+
+#endif